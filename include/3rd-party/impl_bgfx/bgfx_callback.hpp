@@ -5,12 +5,21 @@
 #include <bx/file.h>
 #include <bgfx/bgfx.h>
 #include <bx/readerwriter.h>
+#include <mutex>
+#include <string>
 
 struct AviWriter;
 
 struct BgfxCallback : public bgfx::CallbackI
 {
-	BgfxCallback();
+	/*
+	 * @param[in] cacheDirectory Where compiled programs are cached between
+	 * runs, empty disables the cache
+	 * @param[in] cacheLimit Size of the cache in bytes, the oldest programs
+	 * are removed when it is exceeded
+	 */
+	explicit BgfxCallback(const std::string& cacheDirectory = "../debug/shadercache/",
+		uint64_t cacheLimit = 64 * 1024 * 1024);
 	virtual ~BgfxCallback();
 
 	virtual void fatal(const char* _filePath, uint16_t _line, bgfx::Fatal::Enum _code, const char* _str) override;;
@@ -37,7 +46,31 @@ struct BgfxCallback : public bgfx::CallbackI
 
 	virtual void captureFrame(const void* _data, uint32_t ) override;
 
+private:
+	/*
+	 * Header in front of every cached program, programs written by another
+	 * version, renderer or GPU are ignored
+	 */
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t apiVersion;
+		uint32_t rendererType;
+		uint16_t vendorId;
+		uint16_t deviceId;
+		uint32_t size;
+	};
+
+	std::string getCachePath(uint64_t _id) const;
+	CacheHeader getCacheHeader(uint32_t _size) const;
+	void trimCache();
+
 private:
 	bx::FileWriter* fileWriter;
 	AviWriter* aviWriter;
+
+	std::string cacheDirectory;
+	uint64_t cacheLimit;
+	std::mutex cacheMutex;
 };
\ No newline at end of file
@@ -13,6 +13,16 @@ namespace core
 		const char* name = "Project";
 		uint32_t width = 1280;
 		uint32_t height = 720;
+		uint32_t workerCount = 0; // Job system workers, 0 uses all cores but one
+
+		/*
+		 * Lets bgfx render the previous frame on its own thread while the
+		 * main thread updates the layers and submits the next one
+		 *
+		 * @remark Memory given to bgfx::makeRef has to stay alive until its
+		 * release callback runs, two frames later at most
+		 */
+		bool renderThread = false;
 	};
 	
 	class App
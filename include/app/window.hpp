@@ -33,7 +33,8 @@ namespace core
 		};
 
 	public:
-		Window(const char* name, uint32_t width, uint32_t height);
+		Window(const char* name, uint32_t width, uint32_t height,
+			const bool& renderThread = false);
 		~Window();
 
 		void onUpdate();
@@ -45,10 +46,17 @@ namespace core
 		[[nodiscard]] uint32_t getHeight() const { return windowInfo.height; }
 		[[nodiscard]] uint32_t getResetFlags() const { return windowInfo.resetFlags; }
 
+		/*
+		 * True if bgfx renders on its own thread, bgfx::frame() then only
+		 * hands the submitted frame over instead of rendering it
+		 */
+		[[nodiscard]] bool hasRenderThread() const { return renderThread; }
+
 	private:
 		WindowInfo windowInfo;
 
 		GLFWwindow* window;
 		BgfxCallback* bgfxCallback;
+		bool renderThread;
 	};
 }
\ No newline at end of file
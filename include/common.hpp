@@ -20,6 +20,9 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
 
 namespace core
 {
@@ -59,4 +62,43 @@ namespace core
 	{
 		return std::make_shared<T>(std::forward<Args>(args)...);
 	}
+
+	/*
+	 * Non-owning view of a contiguous sequence of T, stand-in for C++20
+	 * std::span
+	 *
+	 * @remark The viewed memory must outlive the span
+	 */
+	template<typename T>
+	class span
+	{
+	public:
+		constexpr span() : ptr(nullptr), count(0) {}
+		constexpr span(T* data, const size_t size) : ptr(data), count(size) {}
+
+		template<typename U, typename = std::enable_if_t<
+			std::is_same_v<std::remove_const_t<T>, U>>>
+		span(std::vector<U>& vector) : ptr(vector.data()), count(vector.size()) {}
+
+		template<typename U, typename = std::enable_if_t<
+			std::is_const_v<T> && std::is_same_v<std::remove_const_t<T>, U>>>
+		span(const std::vector<U>& vector) : ptr(vector.data()), count(vector.size()) {}
+
+		template<size_t N>
+		constexpr span(T (&array)[N]) : ptr(array), count(N) {}
+
+		[[nodiscard]] constexpr T* data() const { return ptr; }
+		[[nodiscard]] constexpr size_t size() const { return count; }
+		[[nodiscard]] constexpr size_t sizeBytes() const { return count * sizeof(T); }
+		[[nodiscard]] constexpr bool empty() const { return count == 0; }
+
+		[[nodiscard]] constexpr T* begin() const { return ptr; }
+		[[nodiscard]] constexpr T* end() const { return ptr + count; }
+
+		constexpr T& operator[](const size_t index) const { return ptr[index]; }
+
+	private:
+		T* ptr;
+		size_t count;
+	};
 }
\ No newline at end of file
@@ -25,5 +25,6 @@
 #include "common.hpp"
 #include "debug.hpp"
 #include "defines.hpp"
+#include "jobs/job_system.hpp"
 #include "math.hpp"
 #include "utils.hpp"
\ No newline at end of file
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Open addressing hash map keyed by StringID, one flat array of slots
+ * probed linearly
+ */
+#pragma once
+
+#include <vector>
+
+#include "defines.hpp"
+#include "string_id.hpp"
+
+namespace core
+{
+	template<typename T>
+	class FlatMap
+	{
+	public:
+		struct Slot
+		{
+			StringID key;
+			T value;
+		};
+
+		template<typename SlotT>
+		class Iterator
+		{
+		public:
+			Iterator(SlotT* slot, SlotT* end) : slot(slot), end(end) { skipEmpty(); }
+
+			SlotT& operator*() const { return *slot; }
+			SlotT* operator->() const { return slot; }
+			Iterator& operator++() { slot++; skipEmpty(); return *this; }
+			bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+		private:
+			void skipEmpty()
+			{
+				while (slot != end && !slot->key.isValid())
+				{
+					slot++;
+				}
+			}
+
+		private:
+			SlotT* slot;
+			SlotT* end;
+		};
+
+	public:
+		FlatMap() : count(0) {}
+
+		/*!
+		 * Finds the value of a key
+		 *
+		 * @param[in] key The key
+		 *
+		 * @return The value, nullptr if the key is missing
+		 */
+		T* find(const StringID& key)
+		{
+			const size_t index = findSlot(key);
+			return (index != npos) ? &slots[index].value : nullptr;
+		}
+
+		const T* find(const StringID& key) const
+		{
+			const size_t index = findSlot(key);
+			return (index != npos) ? &slots[index].value : nullptr;
+		}
+
+		/*!
+		 * Finds the value of a key, inserting a default value if it is
+		 * missing
+		 *
+		 * @remark The key must be valid, zero marks empty slots
+		 *
+		 * @param[in] key The key
+		 *
+		 * @return The value
+		 */
+		T& operator[](const StringID& key)
+		{
+			ASSERT(key.isValid(), "Invalid key can't be inserted");
+			if (T* value = find(key))
+			{
+				return *value;
+			}
+
+			// Grow at 3/4 load
+			if ((count + 1) * 4 > slots.size() * 3)
+			{
+				rehash(slots.empty() ? 8 : slots.size() * 2);
+			}
+
+			size_t index = getHome(key);
+			while (slots[index].key.isValid())
+			{
+				index = (index + 1) & (slots.size() - 1);
+			}
+
+			slots[index].key = key;
+			count++;
+			return slots[index].value;
+		}
+
+		/*!
+		 * Removes a key
+		 *
+		 * @param[in] key The key
+		 *
+		 * @return True if the key was present
+		 */
+		bool erase(const StringID& key)
+		{
+			size_t index = findSlot(key);
+			if (index == npos)
+			{
+				return false;
+			}
+
+			// Shift following entries back into the hole instead of leaving
+			// a tombstone
+			const size_t mask = slots.size() - 1;
+			size_t next = (index + 1) & mask;
+			while (slots[next].key.isValid())
+			{
+				const size_t home = getHome(slots[next].key);
+				if (((next - home) & mask) >= ((next - index) & mask))
+				{
+					slots[index] = std::move(slots[next]);
+					index = next;
+				}
+				next = (next + 1) & mask;
+			}
+
+			slots[index] = Slot();
+			count--;
+			return true;
+		}
+
+		void clear()
+		{
+			slots.clear();
+			count = 0;
+		}
+
+		[[nodiscard]] size_t size() const { return count; }
+		[[nodiscard]] bool empty() const { return count == 0; }
+
+		Iterator<Slot> begin() { return { slots.data(), slots.data() + slots.size() }; }
+		Iterator<Slot> end() { return { slots.data() + slots.size(), slots.data() + slots.size() }; }
+		Iterator<const Slot> begin() const { return { slots.data(), slots.data() + slots.size() }; }
+		Iterator<const Slot> end() const { return { slots.data() + slots.size(), slots.data() + slots.size() }; }
+
+	private:
+		static constexpr size_t npos = ~static_cast<size_t>(0);
+
+		size_t getHome(const StringID& key) const
+		{
+			// The low bits of FNV-1a are well mixed, no further hashing
+			return static_cast<size_t>(key.getValue()) & (slots.size() - 1);
+		}
+
+		size_t findSlot(const StringID& key) const
+		{
+			if (slots.empty() || !key.isValid())
+			{
+				return npos;
+			}
+
+			size_t index = getHome(key);
+			while (slots[index].key.isValid())
+			{
+				if (slots[index].key == key)
+				{
+					return index;
+				}
+				index = (index + 1) & (slots.size() - 1);
+			}
+			return npos;
+		}
+
+		void rehash(const size_t capacity)
+		{
+			std::vector<Slot> old = std::move(slots);
+			slots.clear();
+			slots.resize(capacity);
+
+			for (Slot& slot : old)
+			{
+				if (slot.key.isValid())
+				{
+					size_t index = getHome(slot.key);
+					while (slots[index].key.isValid())
+					{
+						index = (index + 1) & (capacity - 1);
+					}
+					slots[index] = std::move(slot);
+				}
+			}
+		}
+
+	private:
+		std::vector<Slot> slots;
+		size_t count;
+	};
+}
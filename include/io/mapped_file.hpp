@@ -0,0 +1,60 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Read only memory mapped files
+ */
+#pragma once
+
+#include <string>
+
+#include "common.hpp"
+
+namespace core
+{
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::string& filename);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) = delete;
+
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) = delete;
+
+		[[nodiscard]] bool isValid() const { return data != nullptr; }
+		[[nodiscard]] const uint8_t* getData() const { return data; }
+		[[nodiscard]] size_t getSize() const { return size; }
+
+		/*!
+		 * Maps a whole file into memory for reading
+		 *
+		 * @param[in] filename The directory and filename of the file
+		 *
+		 * @return The mapped file, nullptr if the file could not be mapped
+		 */
+		static ref<MappedFile> create(const std::string& filename);
+
+	private:
+		const uint8_t* data;
+		size_t size;
+
+		void* fileHandle;
+		void* mappingHandle;
+	};
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Versioned binary container for imported meshes, loaded by memory mapping
+ * it and handing the mapped geometry straight to bgfx
+ */
+#pragma once
+
+#include <string>
+
+#include "common.hpp"
+#include "io/mapped_file.hpp"
+#include "math/bounds.hpp"
+#include "renderer/mesh.hpp"
+
+namespace core
+{
+	/*
+	 * Geometry of one mesh to write to a cache
+	 */
+	struct MeshCacheData
+	{
+		span<const MeshVertex> vertices;
+		span<const uint32_t> indices;
+		uint32_t materialSlot = 0;
+	};
+
+	class MeshCache
+	{
+	public:
+		/*
+		 * Increase whenever the layout of the file or of MeshVertex changes
+		 */
+		static constexpr uint32_t version = 1;
+
+		MeshCache(const ref<MappedFile>& file);
+		~MeshCache() = default;
+
+		MeshCache(const MeshCache&) = default;
+		MeshCache(MeshCache&&) = default;
+
+		MeshCache& operator=(const MeshCache&) = default;
+		MeshCache& operator=(MeshCache&&) = default;
+
+		/*!
+		 * Creates a mesh, the geometry is uploaded from the mapped file
+		 * without copying
+		 *
+		 * @param[in] index Index of the mesh in the cache
+		 * @param[in] params Mesh parameters
+		 *
+		 * @return The mesh
+		 */
+		ref<Mesh> createMesh(const uint32_t& index, const MeshParams& params) const;
+
+		[[nodiscard]] uint32_t getMeshCount() const;
+		[[nodiscard]] uint32_t getMaterialSlot(const uint32_t& index) const;
+
+		/*!
+		 * Opens a cache written for a source file
+		 *
+		 * @remark The source is only hashed if its size matches but its
+		 * modification time does not, e.g. after a fresh checkout
+		 *
+		 * @param[in] filename The directory and filename of the cache
+		 * @param[in] sourceFilename The file the cache was imported from
+		 * @param[in] importFlags Import settings the cache must match
+		 *
+		 * @return The cache, nullptr if it is missing, corrupt, of another
+		 * version or out of date
+		 */
+		static ref<MeshCache> open(const std::string& filename,
+			const std::string& sourceFilename, const uint32_t& importFlags);
+
+		/*!
+		 * Writes a cache for a source file
+		 *
+		 * @param[in] filename The directory and filename of the cache
+		 * @param[in] sourceFilename The file the meshes were imported from
+		 * @param[in] importFlags Import settings used for the meshes
+		 * @param[in] meshes The meshes to write
+		 *
+		 * @return True if the cache was written
+		 */
+		static bool write(const std::string& filename,
+			const std::string& sourceFilename, const uint32_t& importFlags,
+			span<const MeshCacheData> meshes);
+
+	private:
+		struct Header;
+		struct Entry;
+
+		[[nodiscard]] const Header& getHeader() const;
+		[[nodiscard]] const Entry& getEntry(const uint32_t& index) const;
+
+	private:
+		ref<MappedFile> file;
+	};
+}
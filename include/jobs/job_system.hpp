@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Runs small jobs on a fixed set of worker threads. Every worker owns a
+ * work stealing deque, idle workers steal from the others, and a thread
+ * waiting on a counter runs jobs instead of blocking
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "common.hpp"
+
+namespace core
+{
+	struct Job;
+
+	struct JobSystemParams
+	{
+		uint32_t workerCount = 0; // Worker threads, 0 uses all cores but one
+		uint32_t queueSize = 4096; // Jobs per worker deque, power of two
+	};
+
+	/*
+	 * Counts unfinished jobs, used to wait for them or to start jobs once
+	 * they are done
+	 */
+	class JobCounter
+	{
+	public:
+		JobCounter() : count(0) {}
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		[[nodiscard]] bool isDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> count;
+
+		// Jobs started when the count reaches zero
+		std::mutex mutex;
+		std::vector<Job*> dependents;
+	};
+
+	class JobSystem
+	{
+	public:
+		static void init(const JobSystemParams& params = JobSystemParams());
+		static void shutdown();
+
+		[[nodiscard]] static bool isInitialized();
+
+		/*!
+		 * Runs a job on any thread
+		 *
+		 * @remark The counter and dependency have to outlive the job
+		 *
+		 * @param[in] function The job
+		 * @param[in] counter Counter incremented now and decremented once
+		 * the job finishes, may be nullptr
+		 * @param[in] dependency The job does not start before this counter
+		 * reaches zero, may be nullptr
+		 */
+		static void run(std::function<void()> function,
+			JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+		/*!
+		 * Waits until a counter reaches zero, running other jobs meanwhile
+		 *
+		 * @param[in] counter The counter
+		 */
+		static void wait(JobCounter& counter);
+
+		/*!
+		 * Calls a function for every index in batches spread over the
+		 * workers and waits for all of them, runs inline if the job system
+		 * is not initialized
+		 *
+		 * @param[in] count Number of indices
+		 * @param[in] batchSize Indices per job, larger batches have less
+		 * overhead but balance worse
+		 * @param[in] function Called with the first and one past the last
+		 * index of a batch
+		 */
+		static void parallelFor(const uint32_t& count, const uint32_t& batchSize,
+			const std::function<void(uint32_t, uint32_t)>& function);
+
+		/*
+		 * Number of threads that run jobs, the workers and the thread that
+		 * called init()
+		 */
+		[[nodiscard]] static uint32_t getThreadCount();
+
+		/*
+		 * Index of the calling thread in [0, getThreadCount()), 0 is the
+		 * thread that called init(). Other threads get UINT32_MAX
+		 */
+		[[nodiscard]] static uint32_t getThreadIndex();
+
+	private:
+		static void workerMain(const uint32_t& index);
+		static void schedule(Job* job);
+		static Job* findJob();
+		static void execute(Job* job);
+		static void finish(JobCounter* counter);
+	};
+}
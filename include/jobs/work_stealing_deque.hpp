@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Chase-Lev work stealing deque, the owning thread pushes and pops at the
+ * bottom while any other thread steals from the top
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "defines.hpp"
+
+namespace core
+{
+	template<typename T>
+	class WorkStealingDeque
+	{
+	public:
+		/*!
+		 * @param[in] capacity Maximum number of items, has to be a power of
+		 * two
+		 */
+		explicit WorkStealingDeque(const uint32_t capacity)
+			: top(0), bottom(0), mask(capacity - 1)
+			, items(new std::atomic<T*>[capacity])
+		{
+			ASSERT(capacity && !(capacity & (capacity - 1)),
+				"Deque capacity is not a power of two");
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		/*!
+		 * Pushes an item at the bottom, owning thread only
+		 *
+		 * @param[in] item The item
+		 *
+		 * @return False if the deque is full
+		 */
+		bool push(T* item)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t > static_cast<int64_t>(mask))
+			{
+				return false;
+			}
+
+			items[b & mask].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/*!
+		 * Pops the most recently pushed item, owning thread only
+		 *
+		 * @return The item, nullptr if the deque is empty
+		 */
+		T* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+
+			if (t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			T* item = items[b & mask].load(std::memory_order_relaxed);
+			if (t == b)
+			{
+				// Last item, race the thieves for it
+				if (!top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					item = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		/*!
+		 * Steals the least recently pushed item, any thread
+		 *
+		 * @return The item, nullptr if the deque is empty or another thread
+		 * took it first
+		 */
+		T* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+
+			if (t >= b)
+			{
+				return nullptr;
+			}
+
+			T* item = items[t & mask].load(std::memory_order_relaxed);
+			if (!top.compare_exchange_strong(t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return item;
+		}
+
+		[[nodiscard]] bool empty() const
+		{
+			return bottom.load(std::memory_order_relaxed) <=
+				top.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// Thieves and the owner touch different ends, keep them on
+		// separate cache lines
+		alignas(64) std::atomic<int64_t> top;
+		alignas(64) std::atomic<int64_t> bottom;
+		int64_t mask;
+		std::unique_ptr<std::atomic<T*>[]> items;
+	};
+}
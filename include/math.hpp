@@ -21,11 +21,15 @@
 
 #include "common.hpp"
 #include "math/transform.hpp"
+#include "math/bounds.hpp"
 
 /*
  * Forward Declarations
  */
-class Camera;
+namespace core
+{
+	class Camera;
+}
 
 namespace core::math
 {
@@ -74,6 +78,21 @@ namespace core::math
 	glm::vec3 screenToWorldSpace(const glm::vec2& screenSpace,
 		const ref<Camera>& camera, const float& depth = 2.0f); 
 
+	/*!
+	 * Creates a world space ray going from the camera through a point on
+	 * the screen, used for picking
+	 *
+	 * @remark The screen space point starts from the bottom left corner in
+	 * pixels
+	 *
+	 * @param[in] screenSpace A two dimensional vector in screen space
+	 * @param[in] camera The camera the screen space point belongs to
+	 *
+	 * @return Ray starting at the camera position with a normalized direction
+	 */
+	Ray screenToWorldRay(const glm::vec2& screenSpace,
+		const ref<Camera>& camera);
+
 	/*!
 	 * Tries to find the rotation between two points
 	 *
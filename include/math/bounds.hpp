@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bounding volumes and the tests used for culling
+ */
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace core
+{
+	struct AABB
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+
+		explicit AABB(glm::vec3 min = glm::vec3(0.0f),
+			glm::vec3 max = glm::vec3(0.0f));
+
+		[[nodiscard]] glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+		[[nodiscard]] glm::vec3 getExtents() const { return (max - min) * 0.5f; }
+	};
+
+	struct BoundingSphere
+	{
+		glm::vec3 center;
+		float radius;
+
+		explicit BoundingSphere(glm::vec3 center = glm::vec3(0.0f),
+			float radius = 0.0f);
+	};
+
+	/*
+	 * Six planes in the form (normal, distance) with the normals pointing
+	 * into the frustum. Order is left, right, bottom, top, near, far
+	 */
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+
+		explicit Ray(glm::vec3 origin = glm::vec3(0.0f),
+			glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f));
+	};
+}
+
+namespace core::math
+{
+	/*!
+	 * Computes the smallest box containing all positions
+	 *
+	 * @param[in] positions First position, positions are read with stride
+	 * @param[in] count Number of positions
+	 * @param[in] stride Bytes between two positions
+	 *
+	 * @return Box containing all positions
+	 */
+	AABB computeAABB(const glm::vec3* positions, const uint32_t& count,
+		const uint32_t& stride = sizeof(glm::vec3));
+
+	/*!
+	 * Computes a bounding sphere centered on the box containing all positions
+	 *
+	 * @param[in] positions First position, positions are read with stride
+	 * @param[in] count Number of positions
+	 * @param[in] stride Bytes between two positions
+	 *
+	 * @return Sphere containing all positions
+	 */
+	BoundingSphere computeBoundingSphere(const glm::vec3* positions,
+		const uint32_t& count, const uint32_t& stride = sizeof(glm::vec3));
+
+	/*!
+	 * Transforms a box and returns the box containing the result
+	 *
+	 * @param[in] box The box to transform
+	 * @param[in] matrix The transformation matrix
+	 *
+	 * @return Axis aligned box containing the transformed box
+	 */
+	AABB transformAABB(const AABB& box, const glm::mat4& matrix);
+
+	/*!
+	 * Extracts the frustum planes from a view projection matrix
+	 *
+	 * @param[in] viewProj The combined view and projection matrix
+	 * @param[in] homogeneousDepth True if clip space depth is [-1, 1],
+	 * false if it is [0, 1]
+	 *
+	 * @return Normalized frustum planes
+	 */
+	Frustum extractFrustum(const glm::mat4& viewProj,
+		const bool& homogeneousDepth);
+
+	/*!
+	 * Tests if a box is inside or intersects a frustum
+	 *
+	 * @param[in] frustum The frustum to test against
+	 * @param[in] box The box to test
+	 *
+	 * @return False if the box is completely outside the frustum
+	 */
+	bool isVisible(const Frustum& frustum, const AABB& box);
+
+	/*!
+	 * Tests if a box overlaps another box
+	 *
+	 * @param[in] a First box
+	 * @param[in] b Second box
+	 *
+	 * @return True if the boxes overlap or touch
+	 */
+	bool overlaps(const AABB& a, const AABB& b);
+
+	/*!
+	 * Intersects a ray with a box using the slab method
+	 *
+	 * @param[in] ray The ray to cast, direction does not need to be normalized
+	 * @param[in] box The box to test
+	 * @param[in] maxDistance Hits further away than this are ignored
+	 * @param[out] outDistance Distance along the ray where it enters the
+	 * box, 0 if the ray starts inside the box
+	 *
+	 * @return True if the ray hits the box
+	 */
+	bool intersectRayAABB(const Ray& ray, const AABB& box,
+		const float& maxDistance, float& outDistance);
+
+	/*!
+	 * Tests many boxes against a frustum, four (SSE) or eight (AVX) at a time
+	 *
+	 * @param[in] frustum The frustum to test against
+	 * @param[in] boxes Boxes to test
+	 * @param[in] count Number of boxes
+	 * @param[out] outVisible One entry per box, set to 1 if visible and 0 if
+	 * culled
+	 *
+	 * @return Number of visible boxes
+	 */
+	uint32_t cullAABBs(const Frustum& frustum, const AABB* boxes,
+		const uint32_t& count, uint8_t* outVisible);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Encodings used to store vertex attributes in fewer bytes
+ */
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace core::math
+{
+	/*!
+	 * Maps a unit vector onto the octahedron and unfolds it to a square
+	 *
+	 * @param[in] normal A normalized direction
+	 *
+	 * @return Two components in [-1, 1]
+	 */
+	glm::vec2 octEncode(const glm::vec3& normal);
+
+	/*!
+	 * Reverses octEncode
+	 *
+	 * @param[in] encoded Two components in [-1, 1]
+	 *
+	 * @return Normalized direction
+	 */
+	glm::vec3 octDecode(const glm::vec2& encoded);
+
+	/*!
+	 * Quantizes a value in [-1, 1] to a normalized signed 16 bit integer
+	 *
+	 * @param[in] value The value to quantize, clamped to [-1, 1]
+	 *
+	 * @return The quantized value
+	 */
+	int16_t packSnorm16(const float& value);
+
+	/*!
+	 * Packs four values in [0, 1] in the 10:10:10:2 layout of
+	 * AttribType::Uint10, x in the lowest bits
+	 *
+	 * @param[in] value The values to pack, clamped to [0, 1]
+	 *
+	 * @return The packed values
+	 */
+	uint32_t packUnorm1010102(const glm::vec4& value);
+
+	/*!
+	 * Converts a float to a 16 bit half float
+	 *
+	 * @param[in] value The value to convert
+	 *
+	 * @return The bits of the half float
+	 */
+	uint16_t packHalf(const float& value);
+}
@@ -40,8 +40,29 @@ namespace core
 		Batch& operator=(const Batch&) = default;
 		Batch& operator=(Batch&&) = default;
 
-		void add(const std::vector<MeshVertex>& vertices,
-			const std::vector<uint16_t>& indices);
+		/*!
+		 * Adds geometry to the batch
+		 *
+		 * @remark Batches are flushed before they exceed 65536 vertices so
+		 * they keep 16 bit indices. Geometry larger than that becomes a mesh
+		 * of its own
+		 *
+		 * @param[in] vertices Vertex data
+		 * @param[in] indices Index data
+		 */
+		void add(span<const MeshVertex> vertices, span<const uint16_t> indices);
+		void add(span<const MeshVertex> vertices, span<const uint32_t> indices);
+
+		/*!
+		 * Adds the geometry of a mesh to the batch
+		 *
+		 * @remark The mesh must have been created with keepCpuData, other
+		 * meshes are skipped with an error. If its base color comes from an
+		 * atlas page the batch material binds directly, its texture
+		 * coordinates are remapped to the page
+		 *
+		 * @param[in] mesh The mesh to add
+		 */
 		void add(const ref<Mesh>& mesh);
 		void flush();
 
@@ -50,11 +71,16 @@ namespace core
 		static ref<Batch> create(const BatchParams& params,
 			const ref<Material>& material);
 
+	private:
+		template<typename T>
+		void addIndexed(span<const MeshVertex> vertices, span<const T> indices);
+
 	private:
 		BatchParams params;
 		ref<Material> material; 
 		std::vector<MeshVertex> currBatchedVertices;
 		std::vector<uint16_t> currBatchedIndices;
+		std::vector<MeshVertex> remappedVertices;
 		std::vector<ref<Mesh>> batchedMeshes;
 	};
 }
\ No newline at end of file
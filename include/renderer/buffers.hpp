@@ -58,9 +58,11 @@ namespace core
 		AttribType attribType;
 		uint8_t num;
 		Attrib attrib;
+		bool normalized; // Integer types are read as [0, 1] or [-1, 1]
 
-		BufferElement(const AttribType& attribType, const uint8_t& num, const Attrib& attrib)
-			: attribType(attribType), num(num), attrib(attrib)
+		BufferElement(const AttribType& attribType, const uint8_t& num, const Attrib& attrib,
+			const bool& normalized = false)
+			: attribType(attribType), num(num), attrib(attrib), normalized(normalized)
 		{}
 	};
 
@@ -77,11 +79,46 @@ namespace core
 		std::vector<BufferElement> elements;
 	};
 
+	/*!
+	 * Moves a vector into a bgfx memory reference, the vector is freed by
+	 * bgfx once the data has been uploaded
+	 *
+	 * @param[in] data The data to hand over to bgfx
+	 *
+	 * @return Memory that can be passed to a buffer without copying
+	 */
+	template<typename T>
+	const bgfx::Memory* moveToMemory(std::vector<T>&& data)
+	{
+		auto* owned = new std::vector<T>(std::move(data));
+		return bgfx::makeRef(owned->data(),
+			static_cast<uint32_t>(owned->size() * sizeof(T)),
+			[](void*, void* userData)
+			{
+				delete static_cast<std::vector<T>*>(userData);
+			}, owned);
+	}
+
+	/*!
+	 * References memory owned by someone else, the owner is kept alive
+	 * until bgfx has uploaded the data
+	 *
+	 * @param[in] data The data to reference
+	 * @param[in] size Size of the data in bytes
+	 * @param[in] owner Owner of the data, such as a memory mapped file
+	 *
+	 * @return Memory that can be passed to a buffer without copying
+	 */
+	const bgfx::Memory* shareMemory(const void* data, const uint32_t& size,
+		const ref<void>& owner);
+
 	class VertexBuffer
 	{
 		friend class Renderer;
+		friend class ShadowMaps;
 
 	public:
+		VertexBuffer(const BufferLayout& layout, const bgfx::Memory* memory);
 		VertexBuffer(const BufferLayout& layout, const void* data, 
 			const uint32_t& size);
 		~VertexBuffer();
@@ -92,9 +129,34 @@ namespace core
 		VertexBuffer& operator=(const VertexBuffer&) = default;
 		VertexBuffer& operator=(VertexBuffer&&) = default;
 
+		/*!
+		 * Creates a vertex buffer from a copy of the data
+		 *
+		 * @param[in] layout Layout of a vertex
+		 * @param[in] data Vertex data, only needs to live during the call
+		 * @param[in] size Size of the data in bytes
+		 *
+		 * @return The vertex buffer
+		 */
 		static ref<VertexBuffer> create(const BufferLayout& layout, const void* data, 
 			const uint32_t& size);
 
+		/*!
+		 * Creates a vertex buffer that takes ownership of the data, no copy
+		 * is made
+		 *
+		 * @param[in] layout Layout of a vertex
+		 * @param[in] data Vertex data, moved into bgfx and freed after upload
+		 *
+		 * @return The vertex buffer
+		 */
+		template<typename T>
+		static ref<VertexBuffer> create(const BufferLayout& layout,
+			std::vector<T>&& data)
+		{
+			return makeRef<VertexBuffer>(layout, moveToMemory(std::move(data)));
+		}
+
 	private:
 		bgfx::Attrib::Enum attribToBgfx(const Attrib& attrib);
 		bgfx::AttribType::Enum attribTypeToBgfx(const AttribType& attribType);
@@ -106,9 +168,12 @@ namespace core
 	class IndexBuffer
 	{
 		friend class Renderer;
+		friend class ShadowMaps;
 
 	public:
-		IndexBuffer(const void* data, const uint32_t& size);
+		IndexBuffer(const bgfx::Memory* memory, const bool& index32 = false);
+		IndexBuffer(const void* data, const uint32_t& size,
+			const bool& index32 = false);
 		~IndexBuffer();
 
 		IndexBuffer(const IndexBuffer&) = default;
@@ -117,15 +182,51 @@ namespace core
 		IndexBuffer& operator=(const IndexBuffer&) = default;
 		IndexBuffer& operator=(IndexBuffer&&) = default;
 
-		static ref<IndexBuffer> create(const void* data, const uint32_t& size);
+		/*!
+		 * Creates an index buffer from a copy of the data
+		 *
+		 * @param[in] data Index data, only needs to live during the call
+		 * @param[in] size Size of the data in bytes
+		 * @param[in] index32 True if the indices are 32 bit
+		 *
+		 * @return The index buffer
+		 */
+		static ref<IndexBuffer> create(const void* data, const uint32_t& size,
+			const bool& index32 = false);
+
+		/*!
+		 * Creates a 16 bit index buffer that takes ownership of the data, no
+		 * copy is made
+		 *
+		 * @param[in] indices Index data, moved into bgfx and freed after upload
+		 *
+		 * @return The index buffer
+		 */
+		static ref<IndexBuffer> create(std::vector<uint16_t>&& indices);
+
+		/*!
+		 * Creates a 32 bit index buffer that takes ownership of the data, no
+		 * copy is made
+		 *
+		 * @remark Requires BGFX_CAPS_INDEX32
+		 *
+		 * @param[in] indices Index data, moved into bgfx and freed after upload
+		 *
+		 * @return The index buffer
+		 */
+		static ref<IndexBuffer> create(std::vector<uint32_t>&& indices);
+
+		[[nodiscard]] bool is32Bit() const { return index32; }
 
 	private:
 		bgfx::IndexBufferHandle handle;
+		bool index32;
 	};
 
 	class VertexArray
 	{
 	friend class Renderer;
+	friend class ShadowMaps;
 		
 	public:
 		VertexArray(const ref<VertexBuffer>& vertexBuffer,
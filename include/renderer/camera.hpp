@@ -20,6 +20,7 @@
 
 #include "common.hpp"
 #include "app/app.hpp"
+#include "math/bounds.hpp"
 
 namespace core
 {
@@ -53,7 +54,8 @@ namespace core
 
 		[[nodiscard]] const glm::mat4& getViewMatrix() const { return view; }
 		[[nodiscard]] const glm::mat4& getProjectionMatrix() const { return proj; }
-		[[nodiscard]] const glm::mat4& getViewProjectionMatrix() const { return view * proj; }
+		[[nodiscard]] const glm::mat4& getViewProjectionMatrix() const { return viewProj; }
+		[[nodiscard]] const Frustum& getFrustum() const { return frustum; }
 
 		static ref<Camera> create(const CameraParams& params);
 
@@ -62,5 +64,8 @@ namespace core
 
 		glm::mat4 view;
 		glm::mat4 proj;
+		glm::mat4 viewProj;
+
+		Frustum frustum;
 	};
 }
\ No newline at end of file
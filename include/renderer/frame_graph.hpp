@@ -0,0 +1,237 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Declarative description of a frame. Passes declare the textures they
+ * read and write, the graph culls passes nobody needs, gives the rest view
+ * ids in order and lets transient render targets share memory when their
+ * lifetimes do not overlap
+ */
+#pragma once
+
+#include <functional>
+
+#include "common.hpp"
+#include "flat_map.hpp"
+#include "texture.hpp"
+#include "framebuffer.hpp"
+#include "renderer.hpp"
+
+namespace core
+{
+	class FrameGraph;
+
+	/*
+	 * Handle of a texture in a frame graph, valid until the graph is
+	 * executed
+	 */
+	struct FrameGraphTexture
+	{
+		uint32_t id = UINT32_MAX;
+
+		[[nodiscard]] bool isValid() const { return id != UINT32_MAX; }
+	};
+
+	struct FrameGraphParams
+	{
+		uint16_t firstViewID = 0; // Passes get consecutive view ids from here
+	};
+
+	/*
+	 * Declares what a pass reads and writes, handed to the setup function
+	 * of a pass
+	 */
+	class FrameGraphBuilder
+	{
+	public:
+		/*!
+		 * Creates a transient render target, its memory is only reserved
+		 * from the first to the last pass using it
+		 *
+		 * @param[in] name Name used in logs
+		 * @param[in] params Size and format of the texture
+		 *
+		 * @return The texture
+		 */
+		FrameGraphTexture create(const std::string& name,
+			const Texture2DParams& params);
+
+		/*
+		 * Reads a texture written by an earlier pass, or imported
+		 */
+		FrameGraphTexture read(const FrameGraphTexture& texture);
+
+		/*
+		 * Renders to a texture, attachments are bound in the order they
+		 * are written. Writing clears what earlier passes rendered unless
+		 * the pass also reads the texture
+		 */
+		FrameGraphTexture write(const FrameGraphTexture& texture);
+
+		/*
+		 * Renders to the back buffer, such passes are never culled
+		 */
+		void writeBackbuffer();
+
+		/*
+		 * Keeps the pass even if nothing reads what it writes
+		 */
+		void setSideEffect();
+
+	private:
+		friend class FrameGraph;
+
+		FrameGraphBuilder(FrameGraph& graph, const uint32_t& pass);
+
+	private:
+		FrameGraph& graph;
+		uint32_t pass;
+	};
+
+	/*
+	 * A pass as seen by its execute function
+	 */
+	class FrameGraphPass
+	{
+	public:
+		[[nodiscard]] const std::string& getName() const { return name; }
+
+		/*
+		 * View id, size and framebuffer of the pass, ready for
+		 * Renderer::beginPass
+		 */
+		[[nodiscard]] const PassParams& getPassParams() const { return passParams; }
+
+		/*
+		 * Texture behind a handle the pass declared
+		 */
+		[[nodiscard]] ref<Texture2D> getTexture(const FrameGraphTexture& texture) const;
+
+	private:
+		friend class FrameGraph;
+		friend class FrameGraphBuilder;
+
+		std::string name;
+		std::function<void(const FrameGraphPass&)> execute;
+		const FrameGraph* graph = nullptr;
+
+		std::vector<uint32_t> reads;
+		std::vector<uint32_t> writes;
+		bool backbuffer = false;
+		bool sideEffect = false;
+
+		PassParams passParams;
+	};
+
+	class FrameGraph
+	{
+		friend class FrameGraphBuilder;
+		friend class FrameGraphPass;
+
+	public:
+		explicit FrameGraph(const FrameGraphParams& params = FrameGraphParams());
+
+		FrameGraph(const FrameGraph&) = delete;
+		FrameGraph& operator=(const FrameGraph&) = delete;
+
+		/*!
+		 * Adds a pass, passes run in the order they are added
+		 *
+		 * @param[in] name Name used in logs
+		 * @param[in] setup Called right away to declare the reads and writes
+		 * @param[in] execute Called when the graph executes, unless the pass
+		 * was culled
+		 */
+		void addPass(const std::string& name,
+			const std::function<void(FrameGraphBuilder&)>& setup,
+			std::function<void(const FrameGraphPass&)> execute);
+
+		/*!
+		 * Makes a texture owned by someone else usable by passes, passes
+		 * writing it are never culled
+		 *
+		 * @param[in] name Name used in logs
+		 * @param[in] texture The texture
+		 *
+		 * @return The texture's handle
+		 */
+		FrameGraphTexture importTexture(const std::string& name,
+			const ref<Texture2D>& texture);
+
+		/*!
+		 * Culls and runs the passes, then clears them so the next frame can
+		 * be declared. Transient textures are kept for the next frame
+		 *
+		 * @param[in] width Width of the back buffer
+		 * @param[in] height Height of the back buffer
+		 */
+		void execute(const uint32_t& width, const uint32_t& height);
+
+		[[nodiscard]] const FrameGraphParams& getParams() const { return params; }
+
+		/*
+		 * Passes that ran and were culled in the last execute
+		 */
+		[[nodiscard]] uint32_t getExecutedCount() const { return executedCount; }
+		[[nodiscard]] uint32_t getCulledCount() const { return culledCount; }
+
+		/*
+		 * Render targets the transient textures of the last execute were
+		 * aliased into
+		 */
+		[[nodiscard]] uint32_t getPhysicalTextureCount() const;
+
+		static ref<FrameGraph> create(const FrameGraphParams& params = FrameGraphParams());
+
+	private:
+		struct Resource
+		{
+			std::string name;
+			Texture2DParams params;
+			ref<Texture2D> imported;
+			uint32_t physical = UINT32_MAX;
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0;
+		};
+
+		struct PhysicalTexture
+		{
+			ref<Texture2D> texture;
+			uint32_t lastPass = 0; // Free for passes after this one
+			bool used = false;
+		};
+
+		void cullPasses(std::vector<uint32_t>& outPasses) const;
+		void allocateTextures(const std::vector<uint32_t>& passes);
+		ref<Framebuffer> getFramebuffer(const FrameGraphPass& pass);
+		void reset();
+
+	private:
+		FrameGraphParams params;
+
+		std::vector<FrameGraphPass> passes;
+		std::vector<Resource> resources;
+
+		// Kept between frames, so the same frame every frame allocates nothing
+		std::vector<PhysicalTexture> physicalTextures;
+		FlatMap<ref<Framebuffer>> framebuffers;
+		FlatMap<ref<Framebuffer>> unusedFramebuffers;
+
+		uint32_t executedCount;
+		uint32_t culledCount;
+	};
+}
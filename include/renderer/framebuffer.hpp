@@ -15,16 +15,30 @@ namespace core
 		Framebuffer(const std::vector<ref<Texture2D>>& textures);
 		~Framebuffer();
 
-		Framebuffer(const Framebuffer&) = default;
-		Framebuffer(Framebuffer&&) = default;
+		// Copies would destroy the bgfx framebuffer twice
+		Framebuffer(const Framebuffer&) = delete;
+		Framebuffer(Framebuffer&&) = delete;
 
-		Framebuffer& operator=(const Framebuffer&) = default;
-		Framebuffer& operator=(Framebuffer&&) = default;
+		Framebuffer& operator=(const Framebuffer&) = delete;
+		Framebuffer& operator=(Framebuffer&&) = delete;
 
 		[[nodiscard]] const std::vector<ref<Texture2D>>& getParams() const { return textures; }
 
 		static ref<Framebuffer> create(const std::vector<ref<Texture2D>>& textures);
 
+		/*!
+		 * Creates a framebuffer with render targets borrowed from
+		 * RenderTargetPool, they go back to the pool with the framebuffer
+		 *
+		 * @remark Recreating the framebuffer at a size used recently, such
+		 * as when a window is resized back, reuses the old targets
+		 *
+		 * @param[in] attachments Format and size of every attachment
+		 *
+		 * @return The framebuffer
+		 */
+		static ref<Framebuffer> createPooled(const std::vector<Texture2DParams>& attachments);
+
 	public: // @todo Make private
 		const std::vector<ref<Texture2D>> textures;
 		
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "common.hpp"
+
+namespace core
+{
+	enum class LightType
+	{
+		Point,
+		Spot,
+	};
+
+	struct Light
+	{
+		LightType type = LightType::Point;
+
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); // Spot only
+		glm::vec3 color = glm::vec3(1.0f);
+		float intensity = 1.0f;
+		float range = 10.0f; // No light reaches further
+
+		// Half angles of the spot cone in radians, full intensity inside the
+		// inner angle fading out towards the outer
+		float innerAngle = 0.35f;
+		float outerAngle = 0.5f;
+
+		static ref<Light> create(const Light& light)
+		{
+			return makeRef<Light>(light);
+		}
+	};
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Clustered forward lighting. The view frustum is split into a grid of
+ * froxels, tiles on screen times slices in depth, and every froxel gets
+ * the list of lights reaching it. Shading a pixel then only loops over
+ * the lights of its froxel
+ */
+#pragma once
+
+#include <bgfx/bgfx.h>
+
+#include "common.hpp"
+#include "light.hpp"
+#include "camera.hpp"
+#include "texture.hpp"
+
+namespace core
+{
+	struct LightClustersParams
+	{
+		// Froxel grid, slices are spaced exponentially between the clip
+		// planes so near froxels are not stretched
+		uint16_t gridX = 16;
+		uint16_t gridY = 9;
+		uint16_t gridZ = 24;
+
+		uint32_t maxLights = 4096; // Visible lights per pass, rounded to 256
+		uint32_t maxLightIndices = 256 * 1024; // Froxel light references, rounded to 1024
+	};
+
+	/*
+	 * Builds the froxel light lists for a camera and binds them for the
+	 * uber shader:
+	 *
+	 * s_lights (stage 1, RGBA32F, 256 lights of 4 texels per row)
+	 *   0: world position, range
+	 *   1: color * intensity, type (0 point, 1 spot)
+	 *   2: spot direction, cos(outer angle)
+	 *   3: cos(inner angle)
+	 * s_clusters (stage 2, RG32F, x + y * gridX by z): first index, count
+	 * s_lightIndices (stage 3, R32F, 1024 per row): light of every reference
+	 *
+	 * u_clusterGrid: gridX, gridY, gridZ, light count
+	 * u_clusterDepth: near, far, scale, bias, the slice of a view depth is
+	 * floor(log(depth) * scale - bias). Tiles are indexed from the bottom
+	 * left in normalized device coordinates
+	 */
+	class LightClusters
+	{
+		struct BinnedLight
+		{
+			glm::vec3 center; // View space
+			float radius;
+			uint16_t minX, maxX;
+			uint16_t minY, maxY;
+			uint16_t minZ, maxZ;
+		};
+
+	public:
+		explicit LightClusters(const LightClustersParams& params = LightClustersParams());
+
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+
+		/*!
+		 * Bins lights into the froxels of a camera and uploads the result,
+		 * slices are binned in parallel on the job system
+		 *
+		 * @remark The textures are updated when the frame is submitted, so
+		 * every lit pass of a frame needs its own LightClusters
+		 *
+		 * @param[in] lights Lights to bin, lights outside the frustum are
+		 * skipped
+		 * @param[in] camera Camera the froxels are built from
+		 */
+		void build(const std::vector<ref<Light>>& lights, const Camera& camera);
+
+		/*!
+		 * Binds the froxel data for the next draw of an encoder
+		 *
+		 * @param[in] encoder The encoder
+		 * @param[in] uploadValues Uploads the uniforms too, see
+		 * Material::updateUniforms
+		 */
+		void bind(bgfx::Encoder* encoder, const bool& uploadValues) const;
+
+		[[nodiscard]] const LightClustersParams& getParams() const { return params; }
+		[[nodiscard]] uint32_t getLightCount() const { return lightCount; }
+		[[nodiscard]] uint32_t getIndexCount() const { return indexCount; }
+
+		static ref<LightClusters> create(const LightClustersParams& params = LightClustersParams());
+
+	private:
+		LightClustersParams params;
+
+		ref<Texture2D> lightsTexture;
+		ref<Texture2D> clustersTexture;
+		ref<Texture2D> indicesTexture;
+
+		bgfx::UniformHandle s_lights;
+		bgfx::UniformHandle s_clusters;
+		bgfx::UniformHandle s_lightIndices;
+		bgfx::UniformHandle u_clusterGrid;
+		bgfx::UniformHandle u_clusterDepth;
+
+		glm::vec4 clusterGrid;
+		glm::vec4 clusterDepth;
+		uint32_t lightCount;
+		uint32_t indexCount;
+
+		// Scratch kept between builds
+		std::vector<glm::vec4> lightTexels;
+		std::vector<float> clusterTexels;
+		std::vector<float> indexTexels;
+		std::vector<BinnedLight> binned;
+		std::vector<std::vector<uint32_t>> sliceCandidates;
+		std::vector<std::vector<uint32_t>> sliceCounts;
+		std::vector<std::vector<uint32_t>> sliceIndices;
+	};
+}
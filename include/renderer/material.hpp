@@ -20,8 +20,11 @@
 #include <bgfx/bgfx.h>
 
 #include "common.hpp"
+#include "string_id.hpp"
+#include "flat_map.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
+#include "texture_atlas.hpp"
 
 namespace core
 {
@@ -65,27 +68,81 @@ namespace core
 		Material& operator=(const Material&) = default;
 		Material& operator=(Material&&) = default;
 
-		void addTexture(const ref<Texture2D>& texture, const std::string& name);
-
-		void setBasecolor(const std::string& textureName);
+		void addTexture(const ref<Texture2D>& texture, const StringID& name);
+
+		/*!
+		 * Adds a texture packed in an atlas, the page is bound and texture
+		 * coordinates are remapped to the region
+		 *
+		 * @remark Materials sharing an atlas page can be merged by Batch,
+		 * which bakes the region into the batched texture coordinates
+		 *
+		 * @param[in] atlas The atlas the texture was packed into
+		 * @param[in] region Region returned by TextureAtlas::add
+		 * @param[in] name Name of the texture
+		 */
+		void addTexture(const ref<TextureAtlas>& atlas, const AtlasRegion& region,
+			const StringID& name);
+
+		void setBasecolor(const StringID& textureName);
 		void setBasecolor(const glm::vec4& color);
 
 		[[nodiscard]] ref<Shader> getShader() { return shader; }
+		[[nodiscard]] const std::string& getShaderName() const { return shaderName; }
+		[[nodiscard]] StringID getShaderID() const { return shaderID; }
+
+		/*
+		 * ShaderFeature bits of the material, the shader is the variant
+		 * of getShaderName() with these features
+		 */
+		[[nodiscard]] uint32_t getShaderFeatures() const { return shaderFeatures; }
+		[[nodiscard]] const MaterialParams& getParams() const { return params; }
+		[[nodiscard]] uint16_t getID() const { return id; }
+		[[nodiscard]] const ref<Texture2D>& getBaseColorMap() const { return baseColorMap; }
+
+		/*
+		 * Changes whenever a uniform value of the material changes, unique
+		 * across all materials
+		 */
+		[[nodiscard]] uint64_t getRevision() const { return revision; }
+
+		/*
+		 * Atlas region of the base color map, nullptr unless it was added
+		 * from an atlas
+		 */
+		[[nodiscard]] const AtlasRegion* getBaseColorRegion() const;
 
 		static ref<Material> create(const MaterialParams& params);
 
 	private:
-		void updateUniforms() const;
+		/*
+		 * Binds textures and state on an encoder, uniform values are only
+		 * uploaded with uploadValues since bgfx keeps them between draws
+		 */
+		void updateUniforms(bgfx::Encoder* encoder,
+			const bool& uploadValues = true) const;
+		void updateShader();
+		void markDirty();
 
 	private:
 		MaterialParams params;
+		uint16_t id;
+		uint64_t revision;
+		uint64_t state;
 
+		std::string shaderName;
+		StringID shaderID;
+		uint32_t shaderFeatures;
 		ref<Shader> shader;
 
-		std::unordered_map<std::string, ref<Texture2D>> textures;
+		FlatMap<ref<Texture2D>> textures;
+		FlatMap<AtlasRegion> atlasRegions;
 
 		ref<Texture2D> baseColorMap;
+		StringID baseColorMapName;
 		bgfx::UniformHandle u_BaseColorMap;
+		glm::vec4 baseColorRegion; // xy offset, zw scale
+		bgfx::UniformHandle u_BaseColorRegion;
 
 		glm::vec4 baseColorFactor;
 		bgfx::UniformHandle u_BaseColorFactor;
@@ -19,37 +19,145 @@
 #include "common.hpp"
 
 #include "math/transform.hpp"
+#include "math/bounds.hpp"
 #include "vertex.hpp"
 #include "buffers.hpp"
 #include "material.hpp"
 
 namespace core
 {
+	struct MeshParams
+	{
+		/*
+		 * Keeps a CPU copy of the vertices and indices after upload, needed
+		 * for batching and CPU side processing. Without it the geometry is
+		 * moved to bgfx and freed once uploaded
+		 */
+		bool keepCpuData = false;
+
+		/*
+		 * Format of the uploaded vertices. Packed formats need the "-packed"
+		 * variant of the material's shader and fall back to Float if the
+		 * renderer lacks half or 10 bit attribute support
+		 */
+		VertexFormat vertexFormat = VertexFormat::Float;
+	};
+
 	class Mesh
 	{
 	public:
 		Mesh(std::vector<MeshVertex> vertices, std::vector<uint16_t> indices,
-			const ref<Material>& material);
+			const ref<Material>& material, const MeshParams& params = MeshParams());
+		Mesh(std::vector<MeshVertex> vertices, std::vector<uint32_t> indices,
+			const ref<Material>& material, const MeshParams& params = MeshParams());
+		Mesh(span<const MeshVertex> vertices, span<const uint8_t> indices,
+			const bool& index32, const AABB& bounds,
+			const BoundingSphere& boundingSphere, const ref<void>& owner,
+			const ref<Material>& material, const MeshParams& params = MeshParams());
 		
-		static ref<Mesh> create(const std::vector<MeshVertex>& vertices,
-			const std::vector<uint16_t>& indices,
-			const ref<Material>& material);
+		/*!
+		 * Creates a mesh and uploads its geometry
+		 *
+		 * @remark Pass the vectors with std::move to avoid copying them
+		 *
+		 * @param[in] vertices Vertex data
+		 * @param[in] indices Index data
+		 * @param[in] material Material to draw the mesh with
+		 * @param[in] params Mesh parameters
+		 *
+		 * @return The mesh
+		 */
+		static ref<Mesh> create(std::vector<MeshVertex> vertices,
+			std::vector<uint16_t> indices, const ref<Material>& material,
+			const MeshParams& params = MeshParams());
+
+		/*!
+		 * Creates a mesh from 32 bit indices, uploaded as 16 bit indices if
+		 * the mesh has at most 65536 vertices
+		 *
+		 * @remark Larger meshes need BGFX_CAPS_INDEX32, or have to be split
+		 * with utils::splitMesh first
+		 *
+		 * @param[in] vertices Vertex data
+		 * @param[in] indices Index data
+		 * @param[in] material Material to draw the mesh with
+		 * @param[in] params Mesh parameters
+		 *
+		 * @return The mesh, or nullptr if it needs unsupported 32 bit indices
+		 */
+		static ref<Mesh> create(std::vector<MeshVertex> vertices,
+			std::vector<uint32_t> indices, const ref<Material>& material,
+			const MeshParams& params = MeshParams());
+
+		/*!
+		 * Creates a mesh from geometry owned by someone else, such as a
+		 * memory mapped file, without copying it
+		 *
+		 * @param[in] vertices Vertex data
+		 * @param[in] indices Index data as raw bytes
+		 * @param[in] index32 True if the indices are 32 bit
+		 * @param[in] bounds Precomputed bounds of the vertices
+		 * @param[in] boundingSphere Precomputed bounding sphere of the vertices
+		 * @param[in] owner Kept alive until bgfx no longer reads the data
+		 * @param[in] material Material to draw the mesh with
+		 * @param[in] params Mesh parameters
+		 *
+		 * @return The mesh
+		 */
+		static ref<Mesh> create(span<const MeshVertex> vertices,
+			span<const uint8_t> indices, const bool& index32, const AABB& bounds,
+			const BoundingSphere& boundingSphere, const ref<void>& owner,
+			const ref<Material>& material, const MeshParams& params = MeshParams());
 		
 		void setMaterial(const ref<Material>& material);
 
 		[[nodiscard]] Transform getTransform() const { return transform; }
 		[[nodiscard]] ref<Material> getMaterial() const { return material; }
 		[[nodiscard]] ref<VertexArray> getVertexArray() const { return vao; }
+		[[nodiscard]] const AABB& getBounds() const { return bounds; }
+		[[nodiscard]] const BoundingSphere& getBoundingSphere() const { return boundingSphere; }
 
-		[[nodiscard]] std::vector<MeshVertex> getVertices() const { return vertices; }
-		[[nodiscard]] std::vector<uint16_t> getIndices() const { return indices; }
+		[[nodiscard]] const MeshParams& getParams() const { return params; }
+		[[nodiscard]] VertexFormat getVertexFormat() const { return vertexFormat; }
+
+		/*
+		 * Maps the uploaded positions back to mesh space, identity unless the
+		 * vertex format is Quantized. Only uniform scale and translation, so
+		 * normals stay valid
+		 */
+		[[nodiscard]] const glm::mat4& getDecodeMatrix() const { return decodeMatrix; }
+		[[nodiscard]] uint32_t getVertexCount() const { return vertexCount; }
+		[[nodiscard]] uint32_t getIndexCount() const { return indexCount; }
+
+		/*
+		 * CPU copies of the geometry, empty unless the mesh was created with
+		 * keepCpuData
+		 */
+		[[nodiscard]] bool hasCpuData() const { return !vertices.empty(); }
+		[[nodiscard]] span<const MeshVertex> getVertices() const { return vertices; }
+		[[nodiscard]] span<const uint32_t> getIndices() const { return indices; }
+
+	private:
+		void initFromVector(std::vector<MeshVertex>&& vertices,
+			const ref<IndexBuffer>& indexBuffer);
+		void init(span<const MeshVertex> vertices, const bgfx::Memory* vertexMemory,
+			const ref<IndexBuffer>& indexBuffer);
 
 	private:
+		MeshParams params;
 		ref<Material> material;
 		Transform transform;
 
+		AABB bounds;
+		BoundingSphere boundingSphere;
+
+		VertexFormat vertexFormat;
+		glm::mat4 decodeMatrix;
+
+		uint32_t vertexCount;
+		uint32_t indexCount;
 		std::vector<MeshVertex> vertices;
-		std::vector<uint16_t> indices;
+		std::vector<uint32_t> indices;
 		
 		ref<VertexArray> vao;
 	};
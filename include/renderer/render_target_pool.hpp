@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Recycles render targets, a target whose last reference is dropped goes
+ * back to the pool and is handed out again for the same format, size and
+ * flags a few frames later instead of being destroyed
+ */
+#pragma once
+
+#include "common.hpp"
+#include "texture.hpp"
+
+namespace core
+{
+	struct RenderTargetPoolParams
+	{
+		// Frames a returned target waits before it is handed out again, so
+		// frames still queued for rendering never see it change
+		uint32_t reuseDelay = 2;
+
+		// Returned targets unused for longer are destroyed
+		uint32_t maxIdleFrames = 120;
+	};
+
+	class RenderTargetPool
+	{
+	public:
+		static void init(const RenderTargetPoolParams& params = RenderTargetPoolParams());
+
+		/*!
+		 * Destroys the pooled targets, targets still borrowed are destroyed
+		 * when their last reference is dropped
+		 */
+		static void shutdown();
+
+		/*!
+		 * Borrows a render target, returned to the pool when the last
+		 * reference is dropped
+		 *
+		 * @param[in] params Format, size and sampling of the target
+		 *
+		 * @return The render target
+		 */
+		static ref<Texture2D> acquire(const Texture2DParams& params);
+
+		/*!
+		 * Advances the frame and destroys targets idle for too long, called
+		 * once per frame by App
+		 */
+		static void update();
+
+		/*
+		 * Targets waiting in the pool, and targets created in total
+		 */
+		[[nodiscard]] static uint32_t getFreeCount();
+		[[nodiscard]] static uint32_t getCreatedCount();
+
+		[[nodiscard]] static bool isInitialized();
+
+	private:
+		static void release(Texture2D* texture);
+	};
+}
@@ -21,22 +21,44 @@
 #include "batch.hpp"
 #include "camera.hpp"
 #include "mesh.hpp"
+#include "scene_bvh.hpp"
 #include "math/transform.hpp"
 
-/*
- * Forward Declarations
- */
-class Framebuffer;
-
 namespace core
 {
+	/*
+	 * Forward Declarations
+	 */
+	class Framebuffer;
+	class LightClusters;
+	class ShadowMaps;
+	struct ShadowMapsParams;
+	struct Light;
+
 	struct PassParams
 	{
 		uint16_t id; // order- 0 call first
 		uint64_t states;
 		uint32_t width;
 		uint32_t height;
-		ref<Framebuffer> framebuffer;
+		ref<Framebuffer> framebuffer; // nullptr renders to the back buffer
+
+		// Record submissions and sort them by state at endPass() instead of
+		// submitting them immediately
+		bool sortSubmissions = false;
+
+		// Skip meshes outside the camera frustum
+		bool frustumCulling = true;
+
+		// Bin the renderer's lights for the pass camera and bind them to lit
+		// materials, see LightClusters
+		bool lighting = false;
+	};
+
+	struct PassStats
+	{
+		uint32_t submitted = 0; // Meshes submitted to the pass
+		uint32_t culled = 0;    // Submitted meshes rejected by frustum culling
 	};
 
 	class Renderer
@@ -45,7 +67,21 @@ namespace core
 		static void init();
 		static void shutdown();
 
+		/*!
+		 * Starts a new frame, called once per frame from the main thread
+		 * before any pass begins
+		 */
+		static void beginFrame();
+
 		static bool beginPass(const ref<Camera>& camera, const PassParams& params);
+
+		/*!
+		 * Ends the current pass
+		 *
+		 * @remark If the pass was started with PassParams::sortSubmissions,
+		 * this is where the recorded meshes are sorted and submitted. Large
+		 * passes are culled and encoded on the job system
+		 */
 		static void endPass();
 		static void render(const uint32_t& width, const uint32_t& height);
 		static void getFinalRender();
@@ -53,14 +89,113 @@ namespace core
 		static void submitVertexArray(const ref<VertexArray>& vao,
 			const ref<Shader>& shader);
 		static void submitVertexArray(const ref<VertexArray>& vao,
-			const std::string& shaderName);
+			const StringID& shaderName);
 
 		static void submitVertexArrayTransform(const ref<VertexArray>& vao,
 			const ref<Shader>& shader, const Transform& transform);
 		static void submitMesh(const ref<Mesh>& mesh, const Transform& transform);
+
+		/*!
+		 * Submits the same mesh once for every transform using hardware
+		 * instancing
+		 *
+		 * @remark Falls back to one submitMesh per transform if instancing
+		 * is unsupported or the material's shader has no instanced variant
+		 *
+		 * @param[in] mesh The mesh to draw
+		 * @param[in] transforms World transform of every instance
+		 */
+		static void submitMeshInstanced(const ref<Mesh>& mesh,
+			span<const Transform> transforms);
 		static void submitBatch(const ref<Batch>& batch, 
 			const Transform& transform = Transform());
 
+		/*!
+		 * Submits every mesh of a scene hierarchy, whole subtrees outside the
+		 * camera frustum are culled without visiting their meshes
+		 *
+		 * @param[in] scene The scene to draw
+		 */
+		static void submitScene(const ref<SceneBVH>& scene);
+
+		/*!
+		 * Gets the culling counters of a pass
+		 *
+		 * @remark Counters are reset by beginPass, sorted passes are culled
+		 * at endPass
+		 *
+		 * @param[in] passID The id the pass was started with
+		 *
+		 * @return Submitted and culled mesh counts of the pass
+		 */
+		static const PassStats& getPassStats(uint16_t passID);
+
+		/*!
+		 * Adds a light to the scene, lit passes shade with every added light
+		 *
+		 * @param[in] light The light, changes to it show up the next lit pass
+		 */
+		static void addLight(const ref<Light>& light);
+		static void removeLight(const ref<Light>& light);
+
+		/*!
+		 * Gets the froxel light lists of the last lit pass
+		 *
+		 * @return The light clusters, null before the first lit pass
+		 */
+		static const ref<LightClusters>& getLightClusters();
+
+		/*!
+		 * Draws the cascaded shadow maps of a directional light, lit passes
+		 * drawn after it sample them
+		 *
+		 * @remark The cascades take the views from
+		 * ShadowMapsParams::firstViewID, bgfx draws them before all other
+		 * views and passes can not use them
+		 *
+		 * @param[in] camera Camera the cascades cover
+		 * @param[in] scene Scene the shadow casters are taken from
+		 * @param[in] lightDirection Direction the light shines in
+		 */
+		static void renderShadows(const ref<Camera>& camera,
+			const ref<SceneBVH>& scene, const glm::vec3& lightDirection);
+
+		/*!
+		 * Sets the cascade count, atlas resolution and splits, the atlas is
+		 * recreated by the next renderShadows
+		 *
+		 * @param[in] params The shadow parameters
+		 */
+		static void setShadowParams(const ShadowMapsParams& params);
+		static const ref<ShadowMaps>& getShadowMaps();
+
 		static ref<ShaderManager> getShaderManager();
+
+		/*!
+		 * Gets an encoder to submit draws from the calling thread
+		 *
+		 * @remark The main thread gets bgfx's own encoder. Other threads
+		 * share the bgfx::Init::limits.maxEncoders encoders and have to hand
+		 * theirs back with endEncoder before the frame ends
+		 *
+		 * @return The encoder
+		 */
+		static bgfx::Encoder* beginEncoder();
+		static void endEncoder(bgfx::Encoder* encoder);
+
+	private:
+		static void submitMeshMatrix(const ref<Mesh>& mesh,
+			const glm::mat4& matrix, const AABB& worldBounds);
+		static void bindMaterial(bgfx::Encoder* encoder, const Material& material,
+			uint64_t& uploadedRevision);
+		static void requestTextureSizes(const Material& material,
+			const AABB& worldBounds);
+		static ref<Shader> getMeshShader(const Mesh& mesh, const bool& instanced = false);
+		static uint32_t submitInstances(bgfx::Encoder* encoder,
+			const ref<VertexArray>& vao, bgfx::ProgramHandle instancedProgram,
+			const glm::mat4* matrices, uint32_t count, uint8_t discard,
+			uint32_t depth = 0);
+		static void encodeRuns(uint32_t firstRun, uint32_t lastRun,
+			std::vector<glm::mat4>& matrices);
 	};
 }
\ No newline at end of file
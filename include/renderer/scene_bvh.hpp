@@ -0,0 +1,163 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Dynamic bounding volume hierarchy over the meshes of a scene, used for
+ * hierarchical culling, picking and overlap queries
+ */
+#pragma once
+
+#include "common.hpp"
+#include "defines.hpp"
+#include "mesh.hpp"
+#include "math/bounds.hpp"
+#include "math/transform.hpp"
+
+namespace core
+{
+	struct RaycastHit
+	{
+		uint32_t proxyID = 0;
+		float distance = 0.0f;
+	};
+
+	class SceneBVH
+	{
+		friend class Renderer;
+
+	public:
+		SceneBVH();
+		~SceneBVH() = default;
+
+		SceneBVH(const SceneBVH&) = default;
+		SceneBVH(SceneBVH&&) = default;
+
+		SceneBVH& operator=(const SceneBVH&) = default;
+		SceneBVH& operator=(SceneBVH&&) = default;
+
+		/*!
+		 * Adds a mesh to the hierarchy, placed where the surface area
+		 * heuristic is cheapest
+		 *
+		 * @param[in] mesh The mesh to add
+		 * @param[in] transform World transform of the mesh
+		 *
+		 * @return Proxy id used to update, remove and identify the mesh
+		 */
+		uint32_t add(const ref<Mesh>& mesh, const Transform& transform = Transform());
+
+		/*!
+		 * Removes a mesh from the hierarchy
+		 *
+		 * @param[in] proxyID Id returned by add()
+		 */
+		void remove(const uint32_t& proxyID);
+
+		/*!
+		 * Moves a mesh and refits the bounds of its ancestors
+		 *
+		 * @remark Refitting keeps the tree valid but not optimal, call
+		 * rebuild() after large changes
+		 *
+		 * @param[in] proxyID Id returned by add()
+		 * @param[in] transform New world transform of the mesh
+		 */
+		void setTransform(const uint32_t& proxyID, const Transform& transform);
+
+		/*!
+		 * Rebuilds the whole hierarchy top down using a binned surface area
+		 * heuristic
+		 */
+		void rebuild();
+
+		/*!
+		 * Finds every mesh inside or intersecting a frustum
+		 *
+		 * @param[in] frustum The frustum to test against
+		 * @param[out] outProxies Proxy ids of the visible meshes are appended
+		 */
+		void queryFrustum(const Frustum& frustum,
+			std::vector<uint32_t>& outProxies) const;
+
+		/*!
+		 * Finds every mesh whose bounds overlap a box
+		 *
+		 * @param[in] box The box to test against in world space
+		 * @param[out] outProxies Proxy ids of the overlapping meshes are appended
+		 */
+		void queryOverlap(const AABB& box, std::vector<uint32_t>& outProxies) const;
+
+		/*!
+		 * Finds the closest mesh bounds hit by a ray
+		 *
+		 * @param[in] ray The ray in world space
+		 * @param[out] outHit The closest hit, untouched if nothing was hit
+		 * @param[in] maxDistance Hits further away than this are ignored
+		 *
+		 * @return True if anything was hit
+		 */
+		bool raycast(const Ray& ray, RaycastHit& outHit,
+			const float& maxDistance = CORE_BIG_NUMBER) const;
+
+		[[nodiscard]] const ref<Mesh>& getMesh(const uint32_t& proxyID) const { return proxies[proxyID].mesh; }
+		[[nodiscard]] const Transform& getTransform(const uint32_t& proxyID) const { return proxies[proxyID].transform; }
+		[[nodiscard]] const glm::mat4& getWorldMatrix(const uint32_t& proxyID) const { return proxies[proxyID].matrix; }
+		[[nodiscard]] const AABB& getWorldBounds(const uint32_t& proxyID) const { return nodes[proxies[proxyID].node].bounds; }
+		[[nodiscard]] uint32_t getProxyCount() const { return proxyCount; }
+
+		static ref<SceneBVH> create();
+
+	private:
+		struct Node
+		{
+			AABB bounds;
+			int32_t parent = -1;
+			int32_t left = -1;  // -1 if leaf
+			int32_t right = -1; // Next free node if unused
+			uint32_t proxyID = 0;
+			int32_t height = 0; // 0 for leaves
+
+			[[nodiscard]] bool isLeaf() const { return left == -1; }
+		};
+
+		struct Proxy
+		{
+			ref<Mesh> mesh;
+			Transform transform;
+			glm::mat4 matrix;
+			int32_t node = -1; // -1 if unused
+		};
+
+		int32_t allocateNode();
+		void freeNode(const int32_t& node);
+		void insertLeaf(const int32_t& leaf);
+		void removeLeaf(const int32_t& leaf);
+		void refitAncestors(int32_t node);
+		int32_t balance(const int32_t& node);
+		int32_t buildRange(std::vector<int32_t>& leaves, const uint32_t& begin,
+			const uint32_t& end);
+		void collectLeaves(const int32_t& node, std::vector<uint32_t>& outProxies) const;
+
+	private:
+		std::vector<Node> nodes;
+		int32_t root;
+		int32_t freeList;
+
+		std::vector<Proxy> proxies;
+		std::vector<uint32_t> freeProxies;
+		uint32_t proxyCount;
+	};
+}
@@ -16,14 +16,40 @@
 
 #pragma once
 
-#include <unordered_map>
 #include <string>
 #include <bgfx/bgfx.h>
 
 #include "common.hpp"
+#include "string_id.hpp"
+#include "flat_map.hpp"
 
 namespace core
 {
+	/*
+	 * Feature bits selecting a precompiled variant of a shader, the variant
+	 * of "uber" with Unlit and Packed is "uber-unlit-packed". Suffixes are
+	 * appended in the order of the bits
+	 */
+	enum ShaderFeature : uint32_t
+	{
+		ShaderFeatureNone = 0,
+
+		// Material features
+		ShaderFeatureUnlit = 1 << 0,        // "-unlit"
+		ShaderFeatureBaseColorMap = 1 << 1, // "-basecolormap"
+		ShaderFeatureTwoSided = 1 << 2,     // "-twosided"
+		ShaderFeatureTranslucent = 1 << 3,  // "-translucent"
+
+		// Vertex input features, variants with these can not be skipped
+		ShaderFeaturePacked = 1 << 4,       // "-packed"
+		ShaderFeatureInstanced = 1 << 5,    // "-instanced"
+
+		// Pass features, can not be skipped either
+		ShaderFeatureDepthOnly = 1 << 6,    // "-depth"
+
+		ShaderFeatureMaterialMask = 0xf,
+	};
+
 	class Shader
 	{
 	public:
@@ -47,6 +73,7 @@ namespace core
 
 	private: 
 		friend class Renderer;
+		friend class ShadowMaps;
 
 		bgfx::ProgramHandle handle;
 		std::string name;
@@ -55,14 +82,86 @@ namespace core
 	class ShaderManager
 	{
 	public:
+		explicit ShaderManager(const std::string& directory = "../../shaders/compiled/");
+
 		void loadAndAdd(const std::string& vertexShaderPath,
 			const std::string& fragmentShaderPath);
 		void add(const ref<Shader>& shader);
 		static ref<Shader> load(const std::string& vertexShaderPath,
 			const std::string& fragmentShaderPath);
-		ref<Shader> get(const std::string& name);
+
+		/*!
+		 * Gets a loaded shader
+		 *
+		 * @param[in] name Name of the shader, literals are hashed at compile
+		 * time
+		 *
+		 * @return The shader, nullptr if it is not loaded
+		 */
+		ref<Shader> get(const StringID& name) const;
+
+		/*!
+		 * Gets a variant of a shader, loaded from the shader directory the
+		 * first time it is asked for
+		 *
+		 * @remark Missing variants fall back to the variant with only the
+		 * vertex input features, so material features are optimizations a
+		 * shader does not have to provide
+		 *
+		 * @param[in] name Name of the shader without suffixes
+		 * @param[in] features ShaderFeature bits
+		 *
+		 * @return The variant, nullptr if not even the fallback exists
+		 */
+		ref<Shader> getVariant(const std::string& name, const uint32_t& features);
+
+		/*
+		 * Same as getVariant(std::string), literals would otherwise convert
+		 * to both a std::string and a StringID
+		 */
+		ref<Shader> getVariant(const char* name, const uint32_t& features)
+		{
+			return getVariant(std::string(name), features);
+		}
+
+		/*!
+		 * Gets a variant of a shader by the id of its name, without hashing
+		 * the name
+		 *
+		 * @remark The shader has to have been asked for by name once, so
+		 * the manager knows which files to load
+		 *
+		 * @param[in] name Id of the name of the shader without suffixes
+		 * @param[in] features ShaderFeature bits
+		 *
+		 * @return The variant, nullptr if not even the fallback exists
+		 */
+		ref<Shader> getVariant(const StringID& name, const uint32_t& features);
+
+		/*!
+		 * Gets the name of a variant, such as "uber-basecolormap-packed"
+		 *
+		 * @param[in] name Name of the shader without suffixes
+		 * @param[in] features ShaderFeature bits
+		 *
+		 * @return Name of the variant
+		 */
+		static std::string getVariantName(const std::string& name,
+			const uint32_t& features);
+
+	private:
+		// Resolved variants of one shader by features + 1, including misses
+		struct VariantSet
+		{
+			std::string name;
+			FlatMap<ref<Shader>> shaders;
+		};
+
+		ref<Shader> loadVariant(const std::string& name, const uint32_t& features);
 
 	private:
-		std::unordered_map<std::string, ref<Shader>> shaders;
+		std::string directory;
+		FlatMap<ref<Shader>> shaders;
+		FlatMap<VariantSet> variants;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Cascaded shadow maps of a directional light. The camera frustum is split
+ * in depth and every split gets its own orthographic shadow map, packed
+ * as a tile of one depth atlas
+ */
+#pragma once
+
+#include <glm/glm.hpp>
+#include <bgfx/bgfx.h>
+
+#include "common.hpp"
+#include "camera.hpp"
+#include "texture.hpp"
+#include "framebuffer.hpp"
+#include "scene_bvh.hpp"
+
+namespace core
+{
+	static constexpr uint32_t maxShadowCascades = 4;
+
+	struct ShadowMapsParams
+	{
+		uint16_t cascadeCount = 4; // Up to maxShadowCascades
+		uint16_t atlasSize = 4096; // Width and height of the atlas in texels
+		Texture2DFormat format = Texture2DFormat::D24;
+
+		// Blend between uniform (0) and logarithmic (1) splits
+		float splitLambda = 0.75f;
+
+		// Shadows end here or at the camera far plane, whichever is closer
+		float maxDistance = 100.0f;
+
+		// Cascades draw on consecutive views from here, UINT16_MAX takes the
+		// last views bgfx has. Their views are ordered before all others so
+		// lit passes sample finished maps, passes can not use them
+		uint16_t firstViewID = UINT16_MAX;
+	};
+
+	struct ShadowCascade
+	{
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 proj = glm::mat4(1.0f);
+		glm::mat4 shadowMatrix = glm::mat4(1.0f); // World to atlas uv and depth
+		float splitFar = 0.0f; // View depth the cascade ends at
+		uint32_t casterCount = 0;
+		bool redrawn = false; // False if the last update kept the cached map
+	};
+
+	/*
+	 * Renders and binds the cascades for the uber shader:
+	 *
+	 * s_shadowMap (stage 4): the depth atlas, sampled with comparison
+	 * u_shadowMatrices[4]: world to atlas uv and depth of every cascade
+	 * u_shadowSplits: view depth every cascade ends at
+	 * u_shadowParams: cascade count, atlas texel size
+	 */
+	class ShadowMaps
+	{
+	public:
+		explicit ShadowMaps(const ShadowMapsParams& params = ShadowMapsParams());
+		~ShadowMaps();
+
+		ShadowMaps(const ShadowMaps&) = delete;
+		ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+		/*!
+		 * Fits the cascades to a camera and draws the shadow casters of a
+		 * scene into them, meshes whose material has
+		 * MaterialParams::castShadow set
+		 *
+		 * @remark Cascade bounds snap to a coarse grid in light space, so a
+		 * camera moving a little keeps the cascade. A cascade whose bounds
+		 * and casters are unchanged keeps last frame's map and is not drawn
+		 *
+		 * @param[in] camera Camera the cascades cover
+		 * @param[in] lightDirection Direction the light shines in
+		 * @param[in] scene Scene the casters are taken from
+		 */
+		void update(const Camera& camera, const glm::vec3& lightDirection,
+			const SceneBVH& scene);
+
+		/*!
+		 * Binds the atlas and cascades for the next draw of an encoder
+		 *
+		 * @param[in] encoder The encoder
+		 * @param[in] uploadValues Uploads the uniforms too, see
+		 * Material::updateUniforms
+		 */
+		void bind(bgfx::Encoder* encoder, const bool& uploadValues) const;
+
+		/*!
+		 * Forces every cascade to be drawn on the next update
+		 */
+		void invalidate();
+
+		[[nodiscard]] const ShadowMapsParams& getParams() const { return params; }
+
+		/*
+		 * True if a view is one of the cascade views
+		 */
+		[[nodiscard]] bool isShadowView(const uint16_t& viewID) const
+		{
+			return viewID >= params.firstViewID &&
+				viewID < params.firstViewID + params.cascadeCount;
+		}
+		[[nodiscard]] const ShadowCascade& getCascade(const uint32_t& index) const { return cascades[index]; }
+		[[nodiscard]] const ref<Texture2D>& getAtlas() const { return atlas; }
+
+		static ref<ShadowMaps> create(const ShadowMapsParams& params = ShadowMapsParams());
+
+	private:
+		void fitCascade(const uint32_t& index, const Camera& camera,
+			const glm::mat4& lightView, const float& splitNear,
+			const float& splitFar, const SceneBVH& scene);
+		void drawCascade(const uint32_t& index, const SceneBVH& scene);
+
+	private:
+		ShadowMapsParams params;
+
+		ref<Texture2D> atlas;
+		ref<Framebuffer> framebuffer;
+		uint16_t tilesPerRow;
+		uint16_t tileSize;
+
+		ShadowCascade cascades[maxShadowCascades];
+		uint64_t cascadeKeys[maxShadowCascades]; // Bounds and casters last drawn
+		uint64_t pendingKeys[maxShadowCascades];
+		std::vector<uint32_t> casters[maxShadowCascades]; // Proxy ids
+
+		bgfx::UniformHandle s_shadowMap;
+		bgfx::UniformHandle u_shadowMatrices;
+		bgfx::UniformHandle u_shadowSplits;
+		bgfx::UniformHandle u_shadowParams;
+
+		glm::mat4 shadowMatrices[maxShadowCascades];
+		glm::vec4 shadowSplits;
+		glm::vec4 shadowParams;
+	};
+}
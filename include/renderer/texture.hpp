@@ -78,6 +78,15 @@ namespace core
 		RGB10A2,
 		RG11B10F,
 
+		// Compressed
+		BC1,
+		BC3,
+		BC5,
+		BC7,
+		ETC2,
+		ETC2A,
+		ASTC4x4,
+
 		// Depths
 		D16,
 		D24,
@@ -97,6 +106,7 @@ namespace core
 		bool nearest = false;
 		bool stretch = true;
 		bool isRenderTarget = false;
+		bool compare = false; // Depth is sampled with a less-equal comparison
 
 		uint16_t width = 0;
 		uint16_t height = 0;
@@ -107,6 +117,7 @@ namespace core
 	{
 		friend class Material;
 		friend class Framebuffer;
+		friend class TextureLoader;
 
 	public:
 		Texture2D(const uint8_t* data, const Texture2DParams& params);
@@ -120,14 +131,51 @@ namespace core
 
 		[[nodiscard]] const Texture2DParams& getParams() const { return params; }
 
+		/*
+		 * False while the texture is drawn with a placeholder, see
+		 * TextureLoader
+		 */
+		[[nodiscard]] bool isLoaded() const { return ownsHandle; }
+
+		/*
+		 * True if the mips of the texture are streamed by TextureLoader
+		 */
+		[[nodiscard]] bool isStreamed() const { return streamID != UINT32_MAX; }
+
 		static ref<Texture2D> create(const uint8_t* data,
 			const Texture2DParams& params);
 
+		/*!
+		 * Loads a cooked texture (.dds or .ktx), mips and compressed data are
+		 * uploaded as stored without decoding
+		 *
+		 * @remark If the renderer does not support the stored format it is
+		 * decoded to RGBA8 on the CPU instead. See utils::cookTexture2D
+		 *
+		 * @param[in] filename The directory and filename of the texture
+		 * @param[in] params Sampling parameters, size, format and mips are
+		 * taken from the file
+		 *
+		 * @return The texture, nullptr if the file could not be read
+		 */
+		static ref<Texture2D> load(const std::string& filename,
+			const Texture2DParams& params = Texture2DParams());
+
+		static bgfx::TextureFormat::Enum toBGFX(Texture2DFormat format);
+
 	private:
-		bgfx::TextureFormat::Enum Texture2D::toBGFX(Texture2DFormat format);
+		Texture2D(const Texture2DParams& params, bgfx::TextureHandle handle,
+			const bool& ownsHandle);
+
+		static Texture2DFormat fromBGFX(bgfx::TextureFormat::Enum format);
+		uint64_t getFlags() const;
 
 	public: // @todo make private 
 		Texture2DParams params;
 		bgfx::TextureHandle handle;
+
+	private:
+		bool ownsHandle;
+		uint32_t streamID;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Packs many small textures into a few large pages so meshes using
+ * different textures can share a material and be batched together
+ */
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "common.hpp"
+#include "texture.hpp"
+
+namespace core
+{
+	struct TextureAtlasParams
+	{
+		uint16_t pageSize = 2048;
+		uint16_t padding = 2; // Border around every texture, filled with its edge pixels
+		bool nearest = false;
+	};
+
+	/*
+	 * Where a texture ended up in the atlas, texture coordinates of the
+	 * original texture map to uv * uvScale + uvOffset on the page
+	 */
+	struct AtlasRegion
+	{
+		uint16_t page = 0;
+		glm::vec2 uvOffset = glm::vec2(0.0f);
+		glm::vec2 uvScale = glm::vec2(1.0f);
+
+		[[nodiscard]] glm::vec2 remap(const glm::vec2& uv) const
+		{
+			return uv * uvScale + uvOffset;
+		}
+	};
+
+	class TextureAtlas
+	{
+	public:
+		explicit TextureAtlas(const TextureAtlasParams& params);
+		~TextureAtlas() = default;
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas(TextureAtlas&&) = default;
+
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(TextureAtlas&&) = default;
+
+		/*!
+		 * Packs a texture into the first page with room for it, a new page
+		 * is created when none has
+		 *
+		 * @remark Only texture coordinates inside 0-1 stay valid after
+		 * remapping, repeating textures can not be packed
+		 *
+		 * @param[in] data RGBA8 texture data
+		 * @param[in] width Width of the texture
+		 * @param[in] height Height of the texture
+		 * @param[out] outRegion Where the texture was placed
+		 *
+		 * @return False if the texture is larger than a page
+		 */
+		bool add(const uint8_t* data, const uint16_t& width, const uint16_t& height,
+			AtlasRegion& outRegion);
+
+		/*!
+		 * Decodes a texture file and packs it
+		 *
+		 * @param[in] filename The directory and filename of the texture
+		 * @param[out] outRegion Where the texture was placed
+		 * @param[in] yFlip Flips the rows of the texture
+		 *
+		 * @return False if the texture could not be decoded or is larger
+		 * than a page
+		 */
+		bool add(const std::string& filename, AtlasRegion& outRegion,
+			const bool& yFlip = false);
+
+		[[nodiscard]] const ref<Texture2D>& getPage(const uint16_t& page) const { return pages[page].texture; }
+		[[nodiscard]] uint16_t getPageCount() const { return static_cast<uint16_t>(pages.size()); }
+		[[nodiscard]] const TextureAtlasParams& getParams() const { return params; }
+
+		static ref<TextureAtlas> create(const TextureAtlasParams& params = TextureAtlasParams());
+
+	private:
+		/*
+		 * Row of packed textures, filled left to right
+		 */
+		struct Shelf
+		{
+			uint16_t y;
+			uint16_t height;
+			uint16_t x;
+		};
+
+		struct Page
+		{
+			ref<Texture2D> texture;
+			std::vector<Shelf> shelves;
+			uint16_t nextShelfY = 0;
+		};
+
+		bool allocate(Page& page, const uint16_t& width, const uint16_t& height,
+			uint16_t& outX, uint16_t& outY);
+
+	private:
+		TextureAtlasParams params;
+		std::vector<Page> pages;
+	};
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Decodes textures on the job system and uploads them a few at a time
+ * so loading at runtime never stalls a frame
+ */
+#pragma once
+
+#include "common.hpp"
+#include "texture.hpp"
+
+namespace core
+{
+	struct DecodedTexture;
+	struct StreamedTexture;
+
+	struct TextureLoaderParams
+	{
+		// Shown until a texture has been uploaded
+		std::string placeholderFilename = "../core/assets/textures/no_texture.png";
+
+		// Bytes uploaded per frame, larger textures are uploaded in rows
+		// spread over several frames
+		uint32_t uploadBudget = 4 * 1024 * 1024;
+
+		// Bytes of streamed mips kept on the GPU, least recently used
+		// textures lose their high mips first when it is exceeded
+		uint64_t residencyBudget = 256 * 1024 * 1024;
+
+		// Streamed textures never drop below the mip with this size
+		uint16_t minStreamedSize = 64;
+	};
+
+	class TextureLoader
+	{
+	public:
+		static void init(const TextureLoaderParams& params = TextureLoaderParams());
+		static void shutdown();
+
+		/*!
+		 * Queues a texture for decoding and returns it immediately, the
+		 * texture is drawn with the placeholder until update() uploads it
+		 *
+		 * @remark Textures are uploaded without mips, if a texture fails to
+		 * decode it keeps the placeholder
+		 *
+		 * @param[in] filename The directory and filename of the texture
+		 * @param[in] params Texture parameters, size and channels are filled
+		 * in from the file
+		 * @param[in] yFlip Flips the rows of the texture
+		 *
+		 * @return The texture
+		 */
+		static ref<Texture2D> load(const std::string& filename,
+			const Texture2DParams& params = Texture2DParams(),
+			const bool& yFlip = false);
+
+		/*!
+		 * Queues a texture whose mips are streamed, only the low mips are
+		 * uploaded at first and higher mips follow as requestSize() asks for
+		 * them
+		 *
+		 * @remark The full mip chain is kept in system memory so evicted
+		 * mips can be uploaded again without decoding
+		 *
+		 * @param[in] filename The directory and filename of the texture
+		 * @param[in] params Texture parameters, size and channels are filled
+		 * in from the file
+		 * @param[in] yFlip Flips the rows of the texture
+		 *
+		 * @return The texture
+		 */
+		static ref<Texture2D> loadStreamed(const std::string& filename,
+			const Texture2DParams& params = Texture2DParams(),
+			const bool& yFlip = false);
+
+		/*!
+		 * Reports how large a streamed texture is drawn this frame, the
+		 * largest request of the frame decides which mips are resident
+		 *
+		 * @remark Called by the renderer for every drawn material, ignored
+		 * for textures that are not streamed
+		 *
+		 * @param[in] texture The drawn texture
+		 * @param[in] screenSize Size the texture covers on screen in pixels
+		 */
+		static void requestSize(const Texture2D& texture, const float& screenSize);
+
+		/*!
+		 * Uploads decoded textures until the frame's upload budget is spent,
+		 * called once per frame from the main thread
+		 */
+		static void update();
+
+		/*!
+		 * Gets the number of textures that are not uploaded yet
+		 *
+		 * @return Textures waiting to be decoded or uploaded
+		 */
+		static uint32_t getPendingCount();
+
+		/*!
+		 * Gets the GPU memory used by the resident mips of streamed textures
+		 *
+		 * @return Resident bytes
+		 */
+		static uint64_t getResidentBytes();
+
+	private:
+		static ref<Texture2D> queueTexture(const std::string& filename,
+			const Texture2DParams& params, const bool& yFlip, const bool& streamed);
+		static void uploadTextures(uint32_t& budget);
+		static void startStream(const DecodedTexture& decoded, Texture2D& texture);
+		static void updateStreams(uint32_t& budget);
+		static void setResidentLevel(StreamedTexture& stream, Texture2D& texture,
+			const uint8_t level);
+		static uint64_t evictMips(const uint64_t bytes, const uint32_t keep);
+	};
+}
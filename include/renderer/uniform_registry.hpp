@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Shared uniform handles, every uniform name is created once no matter
+ * how many materials use it
+ */
+#pragma once
+
+#include <string>
+#include <bgfx/bgfx.h>
+
+#include "common.hpp"
+
+namespace core
+{
+	class UniformRegistry
+	{
+	public:
+		/*!
+		 * Gets the handle of a uniform, created the first time its name is
+		 * asked for
+		 *
+		 * @remark Asking for an existing name with another type or count
+		 * is an error
+		 *
+		 * @param[in] name Name of the uniform in the shaders
+		 * @param[in] type Type of the uniform
+		 * @param[in] count Number of array elements
+		 *
+		 * @return The uniform handle
+		 */
+		static bgfx::UniformHandle get(const std::string& name,
+			const bgfx::UniformType::Enum& type, const uint16_t& count = 1);
+
+		/*!
+		 * Destroys every registered uniform, called by Renderer::shutdown
+		 */
+		static void shutdown();
+
+		/*!
+		 * Gets the number of registered uniforms
+		 *
+		 * @return Uniform count
+		 */
+		static uint32_t getCount();
+	};
+}
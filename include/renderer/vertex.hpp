@@ -45,4 +45,41 @@ namespace core
 
 		MeshVertex();
 	};
+
+	/*
+	 * GPU side formats a mesh can be uploaded in, the CPU side is always
+	 * MeshVertex
+	 */
+	enum class VertexFormat
+	{
+		Float,     // MeshVertex as is, 56 bytes
+		Packed,    // PackedMeshVertex, 24 bytes
+		Quantized, // QuantizedMeshVertex, 20 bytes
+	};
+
+	/*
+	 * Normals and tangents are octahedral encoded, the tangent is stored as
+	 * 10:10:10:2 remapped to [0, 1] with the bitangent sign in the last two
+	 * bits (0 is negative). Texture coordinates are half floats
+	 */
+	struct PackedMeshVertex
+	{
+		glm::vec3 position;
+		int16_t normal[2];
+		uint32_t tangent;
+		uint16_t texCoord[2];
+	};
+
+	/*
+	 * Like PackedMeshVertex, with positions stored as normalized 16 bit
+	 * integers relative to the center of the mesh bounds and scaled by its
+	 * largest extent
+	 */
+	struct QuantizedMeshVertex
+	{
+		int16_t position[4];
+		int16_t normal[2];
+		uint32_t tangent;
+		uint16_t texCoord[2];
+	};
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Hashed string identifiers, names are hashed once (at compile time for
+ * literals) and compared as integers afterwards
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace core
+{
+	/*
+	 * 64 bit FNV-1a
+	 *
+	 * @param[in] data The bytes to hash
+	 * @param[in] size Number of bytes
+	 * @param[in] hash Hash to continue from
+	 *
+	 * @return The hash
+	 */
+	constexpr uint64_t hashFNV1a(const char* data, const size_t size,
+		uint64_t hash = 0xcbf29ce484222325ull)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	class StringID
+	{
+	public:
+		constexpr StringID() : value(0) {}
+		constexpr explicit StringID(const uint64_t value) : value(value) {}
+
+		/*
+		 * Hashed at compile time when given a literal, the name is not
+		 * remembered for getString()
+		 */
+		constexpr StringID(const char* string) : value(hash(string, length(string))) {}
+		constexpr StringID(const char* string, const size_t size) : value(hash(string, size)) {}
+
+		/*
+		 * Hashed at run time, debug builds remember the name for getString()
+		 */
+		StringID(const std::string& string);
+
+		[[nodiscard]] constexpr uint64_t getValue() const { return value; }
+		[[nodiscard]] constexpr bool isValid() const { return value != 0; }
+
+		/*!
+		 * Looks up the name of the id
+		 *
+		 * @remark Only debug builds remember names, and only of ids made
+		 * from a std::string or registered with registerString
+		 *
+		 * @return The name, or "?" if it is unknown
+		 */
+		[[nodiscard]] const char* getString() const;
+
+		/*!
+		 * Remembers the name of an id for getString(), does nothing outside
+		 * debug builds
+		 *
+		 * @param[in] string The name
+		 *
+		 * @return The id of the name
+		 */
+		static StringID registerString(const std::string& string);
+
+		constexpr bool operator==(const StringID& other) const { return value == other.value; }
+		constexpr bool operator!=(const StringID& other) const { return value != other.value; }
+
+	private:
+		static constexpr size_t length(const char* string)
+		{
+			size_t size = 0;
+			while (string[size] != '\0')
+			{
+				size++;
+			}
+			return size;
+		}
+
+		// Zero marks an invalid id and empty slots of a FlatMap
+		static constexpr uint64_t hash(const char* data, const size_t size)
+		{
+			const uint64_t result = hashFNV1a(data, size);
+			return result ? result : 1;
+		}
+
+	private:
+		uint64_t value;
+	};
+
+	namespace literals
+	{
+		constexpr StringID operator""_sid(const char* string, const size_t size)
+		{
+			return StringID(string, size);
+		}
+	}
+}
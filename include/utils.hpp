@@ -42,19 +42,151 @@ namespace core::utils
 	uint8_t* loadTexture2D(const std::string& filename,
 		Texture2DParams& outParams, const bool& yFlip = false);
 
+	/*
+	 * Decodes a texture's data, safe to call from any thread
+	 *
+	 * @remark Unlike loadTexture2D there is no fallback texture, the data
+	 * must be released with freeTexture2D
+	 *
+	 * @param[in] filename The directory and filename of the texture
+	 * @param[out] outParams The texture parameters out put used to create
+	 * a texture
+	 * @param[in] yFlip Flips the rows of the texture
+	 *
+	 * @return Texture data in bytes, nullptr if the texture failed to decode
+	 */
+	uint8_t* decodeTexture2D(const std::string& filename,
+		Texture2DParams& outParams, const bool& yFlip = false);
+
+	/*
+	 * Releases texture data returned by decodeTexture2D
+	 *
+	 * @param[in] data The texture data
+	 */
+	void freeTexture2D(uint8_t* data);
+
+	struct TextureCookSettings
+	{
+		// BC1 opaque, BC3 alpha, BC5 normal maps, BC7 quality. ETC2 and
+		// ASTC4x4 for mobile
+		Texture2DFormat format = Texture2DFormat::BC7;
+		bool generateMips = true;
+		bool normalMap = false; // Encode with normal map error metrics
+		bool fast = false; // Faster, lower quality encoding
+		bool yFlip = false;
+	};
+	/*
+	 * Cooks a texture into a GPU compressed texture with precomputed mips
+	 * that Texture2D::load uploads without decoding
+	 *
+	 * @remark Meant for offline asset builds, encoding takes seconds for
+	 * large textures
+	 *
+	 * @param[in] filename The directory and filename of the source texture
+	 * @param[in] outFilename The cooked texture, written as ktx if it ends
+	 * with ".ktx" and dds otherwise
+	 * @param[in] cookSettings Settings to use when cooking the texture
+	 *
+	 * @return True if the cooked texture was written
+	 */
+	bool cookTexture2D(const std::string& filename, const std::string& outFilename,
+		const TextureCookSettings& cookSettings = TextureCookSettings());
+
 	struct MeshLoadSettings
 	{
 		bool isSkeletalMesh = false;
+		bool keepCpuData = false; // Required to batch the loaded meshes
+		VertexFormat vertexFormat = VertexFormat::Float;
+		bool splitLargeMeshes = false; // Split meshes that need 32 bit indices, always without BGFX_CAPS_INDEX32
+		bool optimize = true; // Reorder for the vertex cache, overdraw and fetch
+		bool useCache = true; // Read and write "<filename>.meshcache"
 	};
 	/*
 	 * Loads a mesh's data
 	 *
 	 * @param[in] filename The directory and filename of the mesh
 	 * @param[in] loadSettings Settings to use when loading mesh
-	 * @param[out] outVertices List of the mesh vertex data
-	 * @param[out] outIndices List of the mesh index data
 	 *
 	 * @return List of mesh pointers
 	 */
 	std::vector<ref<Mesh>> loadMesh(const std::string& filename, const MeshLoadSettings& loadSettings);
-}
\ No newline at end of file
+
+	/*
+	 * Loads a mesh's data
+	 *
+	 * @remark With useCache the first import writes a binary cache next to
+	 * the file, later loads map it and skip the importer
+	 *
+	 * @remark Meshes are processed on the job system when it is
+	 * initialized, GPU resources are still created on the calling thread
+	 *
+	 * @param[in] filename The directory and filename of the mesh
+	 * @param[in] loadSettings Settings to use when loading mesh
+	 * @param[out] outMaterialSlots Material index in the source file of
+	 * every returned mesh
+	 *
+	 * @return List of mesh pointers
+	 */
+	std::vector<ref<Mesh>> loadMesh(const std::string& filename,
+		const MeshLoadSettings& loadSettings, std::vector<uint32_t>& outMaterialSlots);
+
+	/*
+	 * Vertex cache efficiency before and after optimizeMesh. Transformed
+	 * counts are vertex shader invocations simulated with a 16 entry cache
+	 */
+	struct MeshOptimizationStats
+	{
+		uint32_t triangleCount = 0;
+		uint32_t vertexCountBefore = 0;
+		uint32_t vertexCountAfter = 0;
+		uint32_t transformedBefore = 0;
+		uint32_t transformedAfter = 0;
+
+		// Average cache miss ratio, transformed vertices per triangle
+		[[nodiscard]] float getACMRBefore() const { return triangleCount ? static_cast<float>(transformedBefore) / triangleCount : 0.0f; }
+		[[nodiscard]] float getACMRAfter() const { return triangleCount ? static_cast<float>(transformedAfter) / triangleCount : 0.0f; }
+
+		// Average transform to vertex ratio, transformed vertices per vertex
+		[[nodiscard]] float getATVRBefore() const { return vertexCountBefore ? static_cast<float>(transformedBefore) / vertexCountBefore : 0.0f; }
+		[[nodiscard]] float getATVRAfter() const { return vertexCountAfter ? static_cast<float>(transformedAfter) / vertexCountAfter : 0.0f; }
+
+		MeshOptimizationStats& operator+=(const MeshOptimizationStats& other);
+	};
+
+	/*
+	 * Optimizes a triangle list for rendering, in order: welds identical
+	 * vertices, reorders triangles for the post transform vertex cache, then
+	 * in clusters to reduce overdraw, and reorders vertices in the order
+	 * they are fetched
+	 *
+	 * @param[in,out] vertices Vertex data, duplicates are removed
+	 * @param[in,out] indices Triangle list indices
+	 * @param[in] overdrawThreshold How much worse the vertex cache may get
+	 * to reduce overdraw, 1.05 allows 5%
+	 *
+	 * @return Vertex cache statistics before and after
+	 */
+	MeshOptimizationStats optimizeMesh(std::vector<MeshVertex>& vertices,
+		std::vector<uint32_t>& indices, const float& overdrawThreshold = 1.05f);
+
+	struct MeshChunk
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint16_t> indices;
+	};
+
+	/*
+	 * Splits a mesh into chunks small enough for 16 bit indices
+	 *
+	 * @remark Triangles are partitioned by their centers along the longest
+	 * axis, so every chunk covers a compact region and can be culled on
+	 * its own
+	 *
+	 * @param[in] vertices Vertex data of the mesh
+	 * @param[in] indices Triangle list indices of the mesh
+	 * @param[out] outChunks The chunks are appended
+	 * @param[in] maxVertices Maximum number of vertices per chunk
+	 */
+	void splitMesh(span<const MeshVertex> vertices, span<const uint32_t> indices,
+		std::vector<MeshChunk>& outChunks, const uint32_t& maxVertices = 65536);
+}
@@ -1,6 +1,8 @@
 #include "crpch.hpp"
 
 #include <bx/file.h>
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <bimg/bimg.h>
 
@@ -8,9 +10,20 @@
 #include "3rd-party/impl_bgfx/avi_writer.hpp"
 #include "debug/logger.hpp"
 
-BgfxCallback::BgfxCallback()
+static constexpr uint32_t cacheMagic = 0x43534352; // "CRSC"
+static constexpr uint32_t cacheVersion = 1;
+
+BgfxCallback::BgfxCallback(const std::string& cacheDirectory, uint64_t cacheLimit)
+	: fileWriter(nullptr), aviWriter(nullptr)
+	, cacheDirectory(cacheDirectory), cacheLimit(cacheLimit)
 {
 	core::Logger::logInfo("Constructing BGFX Callbacks");
+
+	if (!cacheDirectory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(cacheDirectory, error);
+	}
 }
 
 BgfxCallback::~BgfxCallback()
@@ -70,18 +83,180 @@ void BgfxCallback::profilerEnd()
 {
 }
 
+std::string BgfxCallback::getCachePath(uint64_t _id) const
+{
+	char name[32];
+	bx::snprintf(name, BX_COUNTOF(name), "%016llx.bin", (unsigned long long)_id);
+	return cacheDirectory + name;
+}
+
+BgfxCallback::CacheHeader BgfxCallback::getCacheHeader(uint32_t _size) const
+{
+	// Caps are fixed after init, safe to read from the render thread
+	const bgfx::Caps* caps = bgfx::getCaps();
+
+	CacheHeader header;
+	header.magic = cacheMagic;
+	header.version = cacheVersion;
+	header.apiVersion = BGFX_API_VERSION;
+	header.rendererType = caps->rendererType;
+	header.vendorId = caps->vendorId;
+	header.deviceId = caps->deviceId;
+	header.size = _size;
+	return header;
+}
+
 uint32_t BgfxCallback::cacheReadSize(uint64_t _id) 
 {
-	return 0;
+	if (cacheDirectory.empty())
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	std::ifstream file(getCachePath(_id), std::ios::binary);
+	CacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return 0;
+	}
+
+	const CacheHeader expected = getCacheHeader(header.size);
+	if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		return 0;
+	}
+
+	// Truncated file
+	file.seekg(0, std::ios::end);
+	if (static_cast<uint64_t>(file.tellg()) != sizeof(header) + header.size)
+	{
+		return 0;
+	}
+
+	return header.size;
 }
 
 bool BgfxCallback::cacheRead(uint64_t _id, void* _data, uint32_t _size) 
 {
-	return false;
+	if (cacheDirectory.empty())
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	std::ifstream file(getCachePath(_id), std::ios::binary);
+	CacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return false;
+	}
+
+	const CacheHeader expected = getCacheHeader(_size);
+	if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		return false;
+	}
+
+	if (!file.read(static_cast<char*>(_data), _size))
+	{
+		return false;
+	}
+	file.close();
+
+	// Mark as used, the cache is trimmed least recently used first
+	std::error_code error;
+	std::filesystem::last_write_time(getCachePath(_id),
+		std::filesystem::file_time_type::clock::now(), error);
+	return true;
 }
 
 void BgfxCallback::cacheWrite(uint64_t _id, const void* _data, uint32_t _size) 
 {
+	if (cacheDirectory.empty() || _size > cacheLimit)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	// Written next to the final file and renamed, so readers never see a
+	// partially written program
+	const std::string path = getCachePath(_id);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		const CacheHeader header = getCacheHeader(_size);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(static_cast<const char*>(_data), _size);
+		if (!file)
+		{
+			core::Logger::logWarn("Failed to write shader cache %s", tempPath.c_str());
+			file.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		core::Logger::logWarn("Failed to write shader cache %s", path.c_str());
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+
+	trimCache();
+}
+
+void BgfxCallback::trimCache()
+{
+	struct CacheFile
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type time;
+		uint64_t size;
+	};
+
+	std::error_code error;
+	std::vector<CacheFile> files;
+	uint64_t totalSize = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(cacheDirectory, error))
+	{
+		if (entry.is_regular_file(error) && entry.path().extension() == ".bin")
+		{
+			files.push_back({ entry.path(), entry.last_write_time(error),
+				entry.file_size(error) });
+			totalSize += files.back().size;
+		}
+	}
+
+	if (totalSize <= cacheLimit)
+	{
+		return;
+	}
+
+	// Least recently used first
+	std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b)
+		{
+			return a.time < b.time;
+		});
+
+	for (const CacheFile& file : files)
+	{
+		if (totalSize <= cacheLimit)
+		{
+			break;
+		}
+
+		if (std::filesystem::remove(file.path, error))
+		{
+			totalSize -= file.size;
+		}
+	}
 }
 
 void BgfxCallback::screenShot(const char* _filePath, uint32_t _width, uint32_t _height, uint32_t _pitch, const void* _data, uint32_t , bool _yflip) 
@@ -0,0 +1,10 @@
+#include "crpch.hpp"
+
+#include <meshoptimizer/src/allocator.cpp>
+#include <meshoptimizer/src/indexgenerator.cpp>
+#include <meshoptimizer/src/vcacheoptimizer.cpp>
+#include <meshoptimizer/src/vcacheanalyzer.cpp>
+#include <meshoptimizer/src/overdrawoptimizer.cpp>
+#include <meshoptimizer/src/overdrawanalyzer.cpp>
+#include <meshoptimizer/src/vfetchoptimizer.cpp>
+#include <meshoptimizer/src/vfetchanalyzer.cpp>
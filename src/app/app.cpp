@@ -6,6 +6,9 @@
 
 #include "app/app.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/texture_loader.hpp"
+#include "renderer/render_target_pool.hpp"
+#include "jobs/job_system.hpp"
 #include "debug/logger.hpp"
 
 namespace core
@@ -30,13 +33,21 @@ namespace core
 
 		instance = this;
 
+		// Jobs, shared by the engine and the layers
+		JobSystemParams jobParams;
+		jobParams.workerCount = params.workerCount;
+		JobSystem::init(jobParams);
+
 		// Window
-		window = new Window(params.name, params.width, params.height);
+		window = new Window(params.name, params.width, params.height,
+			params.renderThread);
 		window->setEventCallback(BIND_EVENT_FN(onEvent));
 
 		// Initialize renderer
 		Logger::logInfo("Initializing Renderer...");
 		Renderer::init();
+		TextureLoader::init();
+		RenderTargetPool::init();
 
 		// Layers
 		#ifdef _DEBUG
@@ -69,6 +80,10 @@ namespace core
 
 			if (!isMinimized)
 			{
+				// Swap in textures that finished loading before anything draws
+				TextureLoader::update();
+				Renderer::beginFrame();
+
 				for (Layer* layer : layerStack)
 				{
 					layer->onUpdate(deltaTime);
@@ -87,6 +102,9 @@ namespace core
 
 				window->onUpdate(); 
 
+				// Targets returned this frame become reusable a few frames on
+				RenderTargetPool::update();
+
 				for (Layer* layer : layerStack)
 				{
 					layer->onPostUpdate(deltaTime);
@@ -103,7 +121,10 @@ namespace core
 		{
 			isRunning = false;
 		}
+		TextureLoader::shutdown();
+		RenderTargetPool::shutdown();
 		delete window;
+		JobSystem::shutdown();
 	}
 
 	void App::onEvent(Event& e)
@@ -27,8 +27,9 @@
 
 namespace core
 {
-	Window::Window(const char* name, uint32_t width, uint32_t height)
-		: window(nullptr), bgfxCallback(nullptr)
+	Window::Window(const char* name, uint32_t width, uint32_t height,
+		const bool& renderThread)
+		: window(nullptr), bgfxCallback(nullptr), renderThread(renderThread)
 	{
 		windowInfo.title = name;
 		windowInfo.width = width;
@@ -59,7 +60,25 @@ namespace core
 		}
 
 		// Init Graphics
-		bgfx::renderFrame(); // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
+#if BX_PLATFORM_OSX
+		// Cocoa only allows rendering from the main thread
+		if (this->renderThread)
+		{
+			Logger::logWarn("Render thread is not supported on macOS, rendering on the main thread");
+			this->renderThread = false;
+		}
+#endif
+		if (!this->renderThread)
+		{
+			bgfx::renderFrame(); // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
+		}
+		else
+		{
+			// bgfx creates its own render thread that runs bgfx::renderFrame,
+			// bgfx::frame() then waits for it to finish the previous frame
+			// and hands the new one over
+			Logger::logInfo("Rendering on a separate thread");
+		}
 		bgfx::Init init;
 #if BX_PLATFORM_LINUX || BX_PLATFORM_BSD
 		init.platformData.ndt = glfwGetX11Display();
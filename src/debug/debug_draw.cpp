@@ -25,6 +25,7 @@
 #include "math.hpp"
 #include "renderer/renderer.hpp"
 #include "renderer/shader.hpp"
+#include "renderer/uniform_registry.hpp"
 #include "defines.hpp"
 
 namespace core
@@ -137,7 +138,7 @@ namespace core
 		shader = Renderer::getShaderManager()->get("debugdraw");
 
 		// Uniforms
-		u_color = bgfx::createUniform("u_color", bgfx::UniformType::Vec4);
+		u_color = UniformRegistry::get("u_color", bgfx::UniformType::Vec4);
 
 		Logger::logInfo("Debug Draw allocated debug shapes");
 	#endif
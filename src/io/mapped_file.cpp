@@ -0,0 +1,119 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crpch.hpp"
+
+#include <bx/platform.h>
+
+#if BX_PLATFORM_WINDOWS
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "io/mapped_file.hpp"
+#include "debug/logger.hpp"
+
+namespace core
+{
+	MappedFile::MappedFile(const std::string& filename)
+		: data(nullptr), size(0), fileHandle(nullptr), mappingHandle(nullptr)
+	{
+	#if BX_PLATFORM_WINDOWS
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		fileHandle = file;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			return;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			return;
+		}
+		mappingHandle = mapping;
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		size = data ? static_cast<size_t>(fileSize.QuadPart) : 0;
+	#else
+		const int file = open(filename.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return;
+		}
+
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0)
+		{
+			close(file);
+			return;
+		}
+
+		// The mapping keeps the file referenced, the descriptor is not needed
+		void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ,
+			MAP_PRIVATE, file, 0);
+		close(file);
+
+		if (mapped == MAP_FAILED)
+		{
+			return;
+		}
+
+		data = static_cast<const uint8_t*>(mapped);
+		size = static_cast<size_t>(status.st_size);
+	#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+	#if BX_PLATFORM_WINDOWS
+		if (data)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (mappingHandle)
+		{
+			CloseHandle(static_cast<HANDLE>(mappingHandle));
+		}
+		if (fileHandle)
+		{
+			CloseHandle(static_cast<HANDLE>(fileHandle));
+		}
+	#else
+		if (data)
+		{
+			munmap(const_cast<uint8_t*>(data), size);
+		}
+	#endif
+	}
+
+	ref<MappedFile> MappedFile::create(const std::string& filename)
+	{
+		ref<MappedFile> file = makeRef<MappedFile>(filename);
+		return file->isValid() ? file : nullptr;
+	}
+}
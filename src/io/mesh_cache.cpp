@@ -0,0 +1,334 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crpch.hpp"
+
+#include <filesystem>
+
+#include "io/mesh_cache.hpp"
+#include "string_id.hpp"
+#include "debug/logger.hpp"
+#include "defines.hpp"
+
+namespace core
+{
+	/*
+	 * File layout: header, one entry per mesh, then the vertex and index
+	 * data of every mesh, each aligned to 16 bytes. Everything is stored in
+	 * native byte order
+	 */
+	struct MeshCache::Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+		uint32_t importFlags;
+		uint32_t meshCount;
+	};
+
+	struct MeshCache::Entry
+	{
+		float boundsMin[3];
+		float boundsMax[3];
+		float sphere[4];
+		uint32_t materialSlot;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexSize;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+	};
+
+	static constexpr uint32_t cacheMagic = 0x434d5243; // "CRMC"
+	static constexpr uint64_t cacheAlignment = 16;
+
+	static uint64_t alignOffset(const uint64_t offset)
+	{
+		return (offset + cacheAlignment - 1) & ~(cacheAlignment - 1);
+	}
+
+	static bool getSourceInfo(const std::string& filename, uint64_t& outSize,
+		int64_t& outTime)
+	{
+		std::error_code error;
+		outSize = std::filesystem::file_size(filename, error);
+		if (error)
+		{
+			return false;
+		}
+
+		outTime = static_cast<int64_t>(std::filesystem::last_write_time(filename,
+			error).time_since_epoch().count());
+		return !error;
+	}
+
+	static uint64_t hashSource(const std::string& filename)
+	{
+		const ref<MappedFile> source = MappedFile::create(filename);
+		return source ? hashFNV1a(
+			reinterpret_cast<const char*>(source->getData()), source->getSize()) : 0;
+	}
+
+	MeshCache::MeshCache(const ref<MappedFile>& file)
+		: file(file)
+	{
+		ASSERT(file, "Mesh cache file is invalid");
+	}
+
+	ref<Mesh> MeshCache::createMesh(const uint32_t& index,
+		const MeshParams& params) const
+	{
+		ASSERT(index < getMeshCount(), "Mesh index out of range");
+
+		const Entry& entry = getEntry(index);
+		const span<const MeshVertex> vertices(reinterpret_cast<const MeshVertex*>(
+			file->getData() + entry.vertexOffset), entry.vertexCount);
+		const span<const uint8_t> indices(file->getData() + entry.indexOffset,
+			static_cast<size_t>(entry.indexCount) * entry.indexSize);
+
+		const AABB bounds(glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+			glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]));
+		const BoundingSphere sphere(glm::vec3(entry.sphere[0], entry.sphere[1],
+			entry.sphere[2]), entry.sphere[3]);
+
+		// The mapping stays alive until bgfx has uploaded the geometry
+		return Mesh::create(vertices, indices, entry.indexSize == sizeof(uint32_t),
+			bounds, sphere, file, nullptr, params);
+	}
+
+	uint32_t MeshCache::getMeshCount() const
+	{
+		return getHeader().meshCount;
+	}
+
+	uint32_t MeshCache::getMaterialSlot(const uint32_t& index) const
+	{
+		return getEntry(index).materialSlot;
+	}
+
+	ref<MeshCache> MeshCache::open(const std::string& filename,
+		const std::string& sourceFilename, const uint32_t& importFlags)
+	{
+		ref<MappedFile> file = MappedFile::create(filename);
+		if (!file || file->getSize() < sizeof(Header))
+		{
+			return nullptr;
+		}
+
+		const Header& header = *reinterpret_cast<const Header*>(file->getData());
+		if (header.magic != cacheMagic || header.version != version ||
+			header.importFlags != importFlags)
+		{
+			return nullptr;
+		}
+
+		// Without the source there is nothing to be out of date with
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		bool refreshTime = false;
+		if (getSourceInfo(sourceFilename, sourceSize, sourceTime))
+		{
+			if (sourceSize != header.sourceSize)
+			{
+				return nullptr;
+			}
+
+			if (sourceTime != header.sourceTime)
+			{
+				if (hashSource(sourceFilename) != header.sourceHash)
+				{
+					return nullptr;
+				}
+
+				// Only touched, store the new time so later opens skip the hash
+				refreshTime = true;
+			}
+		}
+
+		// Every range has to be inside the file
+		const uint64_t tableEnd = sizeof(Header) +
+			static_cast<uint64_t>(header.meshCount) * sizeof(Entry);
+		if (tableEnd > file->getSize())
+		{
+			Logger::logWarn("Mesh cache %s is corrupt", filename.c_str());
+			return nullptr;
+		}
+
+		const Entry* entries = reinterpret_cast<const Entry*>(file->getData() +
+			sizeof(Header));
+		for (uint32_t i = 0; i < header.meshCount; i++)
+		{
+			const Entry& entry = entries[i];
+			const uint64_t vertexEnd = entry.vertexOffset +
+				static_cast<uint64_t>(entry.vertexCount) * sizeof(MeshVertex);
+			const uint64_t indexEnd = entry.indexOffset +
+				static_cast<uint64_t>(entry.indexCount) * entry.indexSize;
+
+			if ((entry.indexSize != sizeof(uint16_t) && entry.indexSize != sizeof(uint32_t)) ||
+				entry.vertexOffset % cacheAlignment != 0 ||
+				entry.indexOffset % cacheAlignment != 0 ||
+				vertexEnd > file->getSize() || indexEnd > file->getSize())
+			{
+				Logger::logWarn("Mesh cache %s is corrupt", filename.c_str());
+				return nullptr;
+			}
+		}
+
+		// Unmap while patching, some platforms do not allow writing to a
+		// mapped file. Failing to patch only costs another hash next time
+		if (refreshTime)
+		{
+			const size_t fileSize = file->getSize();
+			file = nullptr;
+			{
+				std::fstream stream(filename, std::ios::binary | std::ios::in |
+					std::ios::out);
+				stream.seekp(offsetof(Header, sourceTime));
+				stream.write(reinterpret_cast<const char*>(&sourceTime),
+					sizeof(sourceTime));
+			}
+
+			file = MappedFile::create(filename);
+			if (!file || file->getSize() != fileSize)
+			{
+				return nullptr;
+			}
+		}
+
+		return makeRef<MeshCache>(file);
+	}
+
+	bool MeshCache::write(const std::string& filename,
+		const std::string& sourceFilename, const uint32_t& importFlags,
+		span<const MeshCacheData> meshes)
+	{
+		Header header = {};
+		header.magic = cacheMagic;
+		header.version = version;
+		header.importFlags = importFlags;
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		if (!getSourceInfo(sourceFilename, header.sourceSize, header.sourceTime))
+		{
+			return false;
+		}
+		header.sourceHash = hashSource(sourceFilename);
+
+		// Lay out the data after the entry table
+		std::vector<Entry> entries(meshes.size());
+		uint64_t offset = alignOffset(sizeof(Header) + meshes.size() * sizeof(Entry));
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const MeshCacheData& mesh = meshes[i];
+			const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+
+			const AABB bounds = math::computeAABB(&mesh.vertices[0].position,
+				vertexCount, sizeof(MeshVertex));
+			const BoundingSphere sphere = math::computeBoundingSphere(
+				&mesh.vertices[0].position, vertexCount, sizeof(MeshVertex));
+
+			Entry& entry = entries[i];
+			entry.boundsMin[0] = bounds.min.x;
+			entry.boundsMin[1] = bounds.min.y;
+			entry.boundsMin[2] = bounds.min.z;
+			entry.boundsMax[0] = bounds.max.x;
+			entry.boundsMax[1] = bounds.max.y;
+			entry.boundsMax[2] = bounds.max.z;
+			entry.sphere[0] = sphere.center.x;
+			entry.sphere[1] = sphere.center.y;
+			entry.sphere[2] = sphere.center.z;
+			entry.sphere[3] = sphere.radius;
+			entry.materialSlot = mesh.materialSlot;
+			entry.vertexCount = vertexCount;
+			entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+			entry.indexSize = (vertexCount <= std::numeric_limits<uint16_t>::max() + 1) ?
+				sizeof(uint16_t) : sizeof(uint32_t);
+
+			entry.vertexOffset = offset;
+			offset = alignOffset(offset + mesh.vertices.sizeBytes());
+			entry.indexOffset = offset;
+			offset = alignOffset(offset + static_cast<uint64_t>(entry.indexCount) *
+				entry.indexSize);
+		}
+
+		// Write next to the target and swap it in, readers never see a
+		// half written cache
+		const std::string tempFilename = filename + ".tmp";
+		std::ofstream stream(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			return false;
+		}
+
+		const char padding[cacheAlignment] = {};
+		auto pad = [&]()
+		{
+			const uint64_t position = static_cast<uint64_t>(stream.tellp());
+			stream.write(padding, static_cast<std::streamsize>(
+				alignOffset(position) - position));
+		};
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		stream.write(reinterpret_cast<const char*>(entries.data()),
+			static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+
+		std::vector<uint16_t> narrowed;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			pad();
+			stream.write(reinterpret_cast<const char*>(meshes[i].vertices.data()),
+				static_cast<std::streamsize>(meshes[i].vertices.sizeBytes()));
+
+			pad();
+			if (entries[i].indexSize == sizeof(uint16_t))
+			{
+				narrowed.assign(meshes[i].indices.begin(), meshes[i].indices.end());
+				stream.write(reinterpret_cast<const char*>(narrowed.data()),
+					static_cast<std::streamsize>(narrowed.size() * sizeof(uint16_t)));
+			}
+			else
+			{
+				stream.write(reinterpret_cast<const char*>(meshes[i].indices.data()),
+					static_cast<std::streamsize>(meshes[i].indices.sizeBytes()));
+			}
+		}
+		pad();
+
+		const bool written = stream.good();
+		stream.close();
+
+		std::error_code error;
+		if (!written)
+		{
+			std::filesystem::remove(tempFilename, error);
+			return false;
+		}
+
+		std::filesystem::rename(tempFilename, filename, error);
+		return !error;
+	}
+
+	const MeshCache::Header& MeshCache::getHeader() const
+	{
+		return *reinterpret_cast<const Header*>(file->getData());
+	}
+
+	const MeshCache::Entry& MeshCache::getEntry(const uint32_t& index) const
+	{
+		return reinterpret_cast<const Entry*>(file->getData() + sizeof(Header))[index];
+	}
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "defines.hpp"
+#include "jobs/job_system.hpp"
+#include "jobs/work_stealing_deque.hpp"
+
+namespace core
+{
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter = nullptr;
+	};
+
+	struct JobSystemData
+	{
+		JobSystemParams params;
+		std::vector<std::thread> workers;
+
+		// One deque per thread index, the main thread owns the first
+		std::vector<std::unique_ptr<WorkStealingDeque<Job>>> queues;
+
+		// Jobs from threads without a deque, or from a full deque
+		std::mutex injectedMutex;
+		std::deque<Job*> injected;
+		std::atomic<uint32_t> injectedCount = 0;
+
+		// Idle workers sleep until a job is queued
+		std::atomic<int32_t> queuedCount = 0;
+		std::atomic<uint32_t> sleepingCount = 0;
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+	};
+	static JobSystemData* data;
+	static thread_local uint32_t threadIndex = UINT32_MAX;
+
+	void JobSystem::init(const JobSystemParams& params)
+	{
+		ASSERT(!data, "Job system is already initialized");
+		data = new JobSystemData();
+		data->params = params;
+
+		const uint32_t workerCount = params.workerCount ? params.workerCount :
+			std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		threadIndex = 0;
+		for (uint32_t i = 0; i <= workerCount; i++)
+		{
+			data->queues.push_back(std::make_unique<WorkStealingDeque<Job>>(
+				params.queueSize));
+		}
+		for (uint32_t i = 1; i <= workerCount; i++)
+		{
+			data->workers.emplace_back(workerMain, i);
+		}
+
+		Logger::logInfo("Job system started %u workers", workerCount);
+	}
+
+	void JobSystem::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(data->sleepMutex);
+			data->stopping = true;
+		}
+		data->wake.notify_all();
+
+		for (std::thread& worker : data->workers)
+		{
+			worker.join();
+		}
+
+		// Nothing may be left behind half done
+		while (Job* job = findJob())
+		{
+			execute(job);
+		}
+
+		delete data;
+		data = nullptr;
+		threadIndex = UINT32_MAX;
+	}
+
+	bool JobSystem::isInitialized()
+	{
+		return data != nullptr;
+	}
+
+	void JobSystem::run(std::function<void()> function, JobCounter* counter,
+		JobCounter* dependency)
+	{
+		ASSERT(data, "Job system is not initialized");
+
+		Job* job = new Job();
+		job->function = std::move(function);
+		job->counter = counter;
+
+		if (counter)
+		{
+			counter->count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (dependency)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (!dependency->isDone())
+			{
+				dependency->dependents.push_back(job);
+				return;
+			}
+		}
+
+		schedule(job);
+	}
+
+	void JobSystem::wait(JobCounter& counter)
+	{
+		while (!counter.isDone())
+		{
+			if (Job* job = findJob())
+			{
+				execute(job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// The last job may still be releasing the counter's dependents
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	void JobSystem::parallelFor(const uint32_t& count, const uint32_t& batchSize,
+		const std::function<void(uint32_t, uint32_t)>& function)
+	{
+		const uint32_t size = std::max(batchSize, 1u);
+		if (!data || count <= size)
+		{
+			if (count)
+			{
+				function(0, count);
+			}
+			return;
+		}
+
+		JobCounter counter;
+		for (uint32_t begin = 0; begin < count; begin += size)
+		{
+			const uint32_t end = std::min(begin + size, count);
+			run([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+		wait(counter);
+	}
+
+	uint32_t JobSystem::getThreadCount()
+	{
+		return data ? static_cast<uint32_t>(data->queues.size()) : 1;
+	}
+
+	uint32_t JobSystem::getThreadIndex()
+	{
+		return threadIndex;
+	}
+
+	void JobSystem::workerMain(const uint32_t& index)
+	{
+		threadIndex = index;
+
+		while (true)
+		{
+			if (Job* job = findJob())
+			{
+				execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(data->sleepMutex);
+			data->sleepingCount++;
+			data->wake.wait(lock, []()
+				{
+					return data->stopping || data->queuedCount.load() > 0;
+				});
+			data->sleepingCount--;
+
+			if (data->stopping)
+			{
+				return;
+			}
+		}
+	}
+
+	void JobSystem::schedule(Job* job)
+	{
+		// Counted before it is visible so the count never goes negative
+		data->queuedCount++;
+
+		const uint32_t index = threadIndex;
+		if (index >= data->queues.size() || !data->queues[index]->push(job))
+		{
+			std::lock_guard<std::mutex> lock(data->injectedMutex);
+			data->injected.push_back(job);
+			data->injectedCount++;
+		}
+
+		// A worker about to sleep has either seen the job or holds the
+		// mutex until it waits, so the notification is not lost
+		if (data->sleepingCount.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(data->sleepMutex);
+			}
+			data->wake.notify_one();
+		}
+	}
+
+	Job* JobSystem::findJob()
+	{
+		const uint32_t queueCount = static_cast<uint32_t>(data->queues.size());
+		const uint32_t index = threadIndex;
+		Job* job = nullptr;
+
+		// Own jobs first, most recent on top for cache locality
+		if (index < queueCount)
+		{
+			job = data->queues[index]->pop();
+		}
+
+		if (!job && data->injectedCount.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(data->injectedMutex);
+			if (!data->injected.empty())
+			{
+				job = data->injected.front();
+				data->injected.pop_front();
+				data->injectedCount--;
+			}
+		}
+
+		// Steal the oldest job of another thread, starting at the next one
+		// so thieves spread out
+		for (uint32_t i = 1; !job && i <= queueCount; i++)
+		{
+			const uint32_t victim = (index + i) % queueCount;
+			if (victim != index)
+			{
+				job = data->queues[victim]->steal();
+			}
+		}
+
+		if (job)
+		{
+			data->queuedCount--;
+		}
+		return job;
+	}
+
+	void JobSystem::execute(Job* job)
+	{
+		job->function();
+		finish(job->counter);
+		delete job;
+	}
+
+	void JobSystem::finish(JobCounter* counter)
+	{
+		if (!counter)
+		{
+			return;
+		}
+
+		std::vector<Job*> ready;
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				ready.swap(counter->dependents);
+			}
+		}
+
+		for (Job* job : ready)
+		{
+			schedule(job);
+		}
+	}
+}
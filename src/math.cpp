@@ -102,6 +102,15 @@ namespace core::math
 		return result;
 	}
 
+	Ray screenToWorldRay(const glm::vec2& screenSpace,
+		const ref<Camera>& camera)
+	{
+		const glm::vec3 origin = camera->getParams().position;
+		const glm::vec3 target = screenToWorldSpace(screenSpace, camera, 1.0f);
+
+		return Ray(origin, glm::normalize(target - origin));
+	}
+
 	glm::vec3 exp(const glm::vec3& a, const glm::vec3& b)
 	{
 		const glm::vec3 result = glm::vec3(
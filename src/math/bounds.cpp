@@ -0,0 +1,286 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crpch.hpp"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define CORE_CULL_AVX
+#elif defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define CORE_CULL_SSE
+#endif
+
+#include "math/bounds.hpp"
+#include "defines.hpp"
+
+namespace core
+{
+	AABB::AABB(const glm::vec3 min, const glm::vec3 max)
+		: min(min)
+		, max(max)
+	{}
+
+	BoundingSphere::BoundingSphere(const glm::vec3 center, const float radius)
+		: center(center)
+		, radius(radius)
+	{}
+
+	Ray::Ray(const glm::vec3 origin, const glm::vec3 direction)
+		: origin(origin)
+		, direction(direction)
+	{}
+}
+
+namespace core::math
+{
+	static const glm::vec3& positionAt(const glm::vec3* positions,
+		const uint32_t index, const uint32_t stride)
+	{
+		return *reinterpret_cast<const glm::vec3*>(
+			reinterpret_cast<const uint8_t*>(positions) + index * stride);
+	}
+
+	AABB computeAABB(const glm::vec3* positions, const uint32_t& count,
+		const uint32_t& stride)
+	{
+		if (count == 0)
+		{
+			return AABB();
+		}
+
+		AABB result(positionAt(positions, 0, stride),
+			positionAt(positions, 0, stride));
+		for (uint32_t i = 1; i < count; i++)
+		{
+			const glm::vec3& position = positionAt(positions, i, stride);
+			result.min = glm::min(result.min, position);
+			result.max = glm::max(result.max, position);
+		}
+
+		return result;
+	}
+
+	BoundingSphere computeBoundingSphere(const glm::vec3* positions,
+		const uint32_t& count, const uint32_t& stride)
+	{
+		const glm::vec3 center = computeAABB(positions, count, stride).getCenter();
+
+		float radiusSquared = 0.0f;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const glm::vec3 offset = positionAt(positions, i, stride) - center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+		}
+
+		return BoundingSphere(center, glm::sqrt(radiusSquared));
+	}
+
+	AABB transformAABB(const AABB& box, const glm::mat4& matrix)
+	{
+		// Transform the center and project the extents on each world axis
+		const glm::vec3 center = glm::vec3(matrix * glm::vec4(box.getCenter(), 1.0f));
+		const glm::vec3 extents = box.getExtents();
+
+		const glm::mat3 absolute = glm::mat3(
+			glm::abs(glm::vec3(matrix[0])),
+			glm::abs(glm::vec3(matrix[1])),
+			glm::abs(glm::vec3(matrix[2])));
+		const glm::vec3 newExtents = absolute * extents;
+
+		return AABB(center - newExtents, center + newExtents);
+	}
+
+	Frustum extractFrustum(const glm::mat4& viewProj,
+		const bool& homogeneousDepth)
+	{
+		// Rows of the matrix, glm is column major
+		const glm::vec4 row0 = glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+		const glm::vec4 row1 = glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+		const glm::vec4 row2 = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+		const glm::vec4 row3 = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+		Frustum result;
+		result.planes[0] = row3 + row0;
+		result.planes[1] = row3 - row0;
+		result.planes[2] = row3 + row1;
+		result.planes[3] = row3 - row1;
+		result.planes[4] = homogeneousDepth ? row3 + row2 : row2;
+		result.planes[5] = row3 - row2;
+
+		for (glm::vec4& plane : result.planes)
+		{
+			const float length = glm::length(glm::vec3(plane));
+			if (length > CORE_VERY_SMALL_NUMBER)
+			{
+				plane /= length;
+			}
+		}
+
+		return result;
+	}
+
+	bool isVisible(const Frustum& frustum, const AABB& box)
+	{
+		const glm::vec3 center = box.getCenter();
+		const glm::vec3 extents = box.getExtents();
+
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const glm::vec3 normal = glm::vec3(plane);
+			const float distance = glm::dot(normal, center) + plane.w;
+			const float radius = glm::dot(glm::abs(normal), extents);
+
+			if (distance + radius < 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool overlaps(const AABB& a, const AABB& b)
+	{
+		return glm::all(glm::lessThanEqual(a.min, b.max)) &&
+			glm::all(glm::lessThanEqual(b.min, a.max));
+	}
+
+	bool intersectRayAABB(const Ray& ray, const AABB& box,
+		const float& maxDistance, float& outDistance)
+	{
+		// Division by zero gives infinities which the slab test handles
+		const glm::vec3 inverse = 1.0f / ray.direction;
+		const glm::vec3 t0 = (box.min - ray.origin) * inverse;
+		const glm::vec3 t1 = (box.max - ray.origin) * inverse;
+
+		const glm::vec3 tMin = glm::min(t0, t1);
+		const glm::vec3 tMax = glm::max(t0, t1);
+
+		const float enter = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+		const float exit = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, maxDistance));
+
+		if (enter > exit)
+		{
+			return false;
+		}
+
+		outDistance = enter;
+		return true;
+	}
+
+	uint32_t cullAABBs(const Frustum& frustum, const AABB* boxes,
+		const uint32_t& count, uint8_t* outVisible)
+	{
+		uint32_t visibleCount = 0;
+		uint32_t i = 0;
+
+	#if defined(CORE_CULL_AVX)
+		constexpr uint32_t width = 8;
+		#define CORE_CULL_TYPE         __m256
+		#define CORE_CULL_LOAD(x)      _mm256_load_ps(x)
+		#define CORE_CULL_SET1(x)      _mm256_set1_ps(x)
+		#define CORE_CULL_ADD(a, b)    _mm256_add_ps(a, b)
+		#define CORE_CULL_MUL(a, b)    _mm256_mul_ps(a, b)
+		#define CORE_CULL_AND(a, b)    _mm256_and_ps(a, b)
+		#define CORE_CULL_GE(a, b)     _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+		#define CORE_CULL_ZERO()       _mm256_setzero_ps()
+		#define CORE_CULL_ONES()       _mm256_castsi256_ps(_mm256_set1_epi32(-1))
+		#define CORE_CULL_MASK(x)      _mm256_movemask_ps(x)
+	#elif defined(CORE_CULL_SSE)
+		constexpr uint32_t width = 4;
+		#define CORE_CULL_TYPE         __m128
+		#define CORE_CULL_LOAD(x)      _mm_load_ps(x)
+		#define CORE_CULL_SET1(x)      _mm_set1_ps(x)
+		#define CORE_CULL_ADD(a, b)    _mm_add_ps(a, b)
+		#define CORE_CULL_MUL(a, b)    _mm_mul_ps(a, b)
+		#define CORE_CULL_AND(a, b)    _mm_and_ps(a, b)
+		#define CORE_CULL_GE(a, b)     _mm_cmpge_ps(a, b)
+		#define CORE_CULL_ZERO()       _mm_setzero_ps()
+		#define CORE_CULL_ONES()       _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps())
+		#define CORE_CULL_MASK(x)      _mm_movemask_ps(x)
+	#endif
+
+	#if defined(CORE_CULL_AVX) || defined(CORE_CULL_SSE)
+		for (; i + width <= count; i += width)
+		{
+			// Boxes as center and extents in structure of arrays layout
+			alignas(32) float cx[width], cy[width], cz[width];
+			alignas(32) float ex[width], ey[width], ez[width];
+			for (uint32_t j = 0; j < width; j++)
+			{
+				const glm::vec3 center = boxes[i + j].getCenter();
+				const glm::vec3 extents = boxes[i + j].getExtents();
+				cx[j] = center.x; cy[j] = center.y; cz[j] = center.z;
+				ex[j] = extents.x; ey[j] = extents.y; ez[j] = extents.z;
+			}
+
+			const CORE_CULL_TYPE centerX = CORE_CULL_LOAD(cx);
+			const CORE_CULL_TYPE centerY = CORE_CULL_LOAD(cy);
+			const CORE_CULL_TYPE centerZ = CORE_CULL_LOAD(cz);
+			const CORE_CULL_TYPE extentX = CORE_CULL_LOAD(ex);
+			const CORE_CULL_TYPE extentY = CORE_CULL_LOAD(ey);
+			const CORE_CULL_TYPE extentZ = CORE_CULL_LOAD(ez);
+
+			CORE_CULL_TYPE visible = CORE_CULL_ONES();
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const CORE_CULL_TYPE distance = CORE_CULL_ADD(CORE_CULL_ADD(
+					CORE_CULL_MUL(CORE_CULL_SET1(plane.x), centerX),
+					CORE_CULL_MUL(CORE_CULL_SET1(plane.y), centerY)),
+					CORE_CULL_ADD(CORE_CULL_MUL(CORE_CULL_SET1(plane.z), centerZ),
+					CORE_CULL_SET1(plane.w)));
+
+				const CORE_CULL_TYPE radius = CORE_CULL_ADD(CORE_CULL_ADD(
+					CORE_CULL_MUL(CORE_CULL_SET1(glm::abs(plane.x)), extentX),
+					CORE_CULL_MUL(CORE_CULL_SET1(glm::abs(plane.y)), extentY)),
+					CORE_CULL_MUL(CORE_CULL_SET1(glm::abs(plane.z)), extentZ));
+
+				visible = CORE_CULL_AND(visible, CORE_CULL_GE(
+					CORE_CULL_ADD(distance, radius), CORE_CULL_ZERO()));
+			}
+
+			const int mask = CORE_CULL_MASK(visible);
+			for (uint32_t j = 0; j < width; j++)
+			{
+				outVisible[i + j] = static_cast<uint8_t>((mask >> j) & 1);
+				visibleCount += outVisible[i + j];
+			}
+		}
+
+		#undef CORE_CULL_TYPE
+		#undef CORE_CULL_LOAD
+		#undef CORE_CULL_SET1
+		#undef CORE_CULL_ADD
+		#undef CORE_CULL_MUL
+		#undef CORE_CULL_AND
+		#undef CORE_CULL_GE
+		#undef CORE_CULL_ZERO
+		#undef CORE_CULL_ONES
+		#undef CORE_CULL_MASK
+	#endif
+
+		// Remaining boxes (or all of them without SIMD)
+		for (; i < count; i++)
+		{
+			outVisible[i] = isVisible(frustum, boxes[i]) ? 1 : 0;
+			visibleCount += outVisible[i];
+		}
+
+		return visibleCount;
+	}
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crpch.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include "math/packing.hpp"
+#include "defines.hpp"
+
+namespace core::math
+{
+	static glm::vec2 signNotZero(const glm::vec2& value)
+	{
+		return glm::vec2(value.x >= 0.0f ? 1.0f : -1.0f,
+			value.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	glm::vec2 octEncode(const glm::vec3& normal)
+	{
+		const float sum = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+		if (sum < CORE_VERY_SMALL_NUMBER)
+		{
+			return glm::vec2(0.0f);
+		}
+
+		const glm::vec3 projected = normal / sum;
+		const glm::vec2 result = glm::vec2(projected);
+
+		// Fold the lower hemisphere over the diagonals
+		if (projected.z < 0.0f)
+		{
+			return (1.0f - glm::abs(glm::vec2(result.y, result.x))) *
+				signNotZero(result);
+		}
+
+		return result;
+	}
+
+	glm::vec3 octDecode(const glm::vec2& encoded)
+	{
+		glm::vec3 result = glm::vec3(encoded,
+			1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+
+		if (result.z < 0.0f)
+		{
+			const glm::vec2 folded = (1.0f - glm::abs(glm::vec2(result.y, result.x))) *
+				signNotZero(glm::vec2(result));
+			result.x = folded.x;
+			result.y = folded.y;
+		}
+
+		return glm::normalize(result);
+	}
+
+	int16_t packSnorm16(const float& value)
+	{
+		return static_cast<int16_t>(glm::round(
+			glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint32_t packUnorm1010102(const glm::vec4& value)
+	{
+		const glm::vec4 clamped = glm::clamp(value, 0.0f, 1.0f);
+		const uint32_t x = static_cast<uint32_t>(glm::round(clamped.x * 1023.0f));
+		const uint32_t y = static_cast<uint32_t>(glm::round(clamped.y * 1023.0f));
+		const uint32_t z = static_cast<uint32_t>(glm::round(clamped.z * 1023.0f));
+		const uint32_t w = static_cast<uint32_t>(glm::round(clamped.w * 3.0f));
+
+		return x | (y << 10) | (z << 20) | (w << 30);
+	}
+
+	uint16_t packHalf(const float& value)
+	{
+		return glm::packHalf1x16(value);
+	}
+}
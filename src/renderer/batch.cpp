@@ -18,6 +18,7 @@
 
 #include "defines.hpp"
 #include "renderer/batch.hpp"
+#include "utils.hpp"
 #include "debug/logger.hpp"
 
 namespace core
@@ -27,25 +28,64 @@ namespace core
 	{
 	}
 
-	void Batch::add(const std::vector<MeshVertex>& vertices,
-		const std::vector<uint16_t>& indices)
+	void Batch::add(span<const MeshVertex> vertices, span<const uint16_t> indices)
+	{
+		addIndexed(vertices, indices);
+	}
+
+	void Batch::add(span<const MeshVertex> vertices, span<const uint32_t> indices)
+	{
+		addIndexed(vertices, indices);
+	}
+
+	template<typename T>
+	void Batch::addIndexed(span<const MeshVertex> vertices, span<const T> indices)
 	{
 		ASSERT(vertices.size() > 0, "Vertices are empty");
 		ASSERT(indices.size() > 0, "Indices are empty");
+
+		// Too large for 16 bit indices, give it a mesh of its own
+		constexpr size_t maxVertices = std::numeric_limits<uint16_t>::max() + 1;
+		if (vertices.size() > maxVertices)
+		{
+			Logger::logWarn("Geometry with %u vertices is too large to batch",
+				static_cast<uint32_t>(vertices.size()));
+
+			// Without 32 bit indices it is batched in chunks instead
+			if (!(bgfx::getCaps()->supported & BGFX_CAPS_INDEX32))
+			{
+				const std::vector<uint32_t> wideIndices(indices.begin(), indices.end());
+				std::vector<utils::MeshChunk> chunks;
+				utils::splitMesh(vertices, wideIndices, chunks,
+					static_cast<uint32_t>(maxVertices));
+				for (const utils::MeshChunk& chunk : chunks)
+				{
+					addIndexed(span<const MeshVertex>(chunk.vertices),
+						span<const uint16_t>(chunk.indices));
+				}
+				return;
+			}
+
+			batchedMeshes.push_back(Mesh::create(
+				std::vector<MeshVertex>(vertices.begin(), vertices.end()),
+				std::vector<uint32_t>(indices.begin(), indices.end()), material));
+			return;
+		}
 		
 		const size_t dataCount = (vertices.size() + indices.size()) +
 			(currBatchedVertices.size() + currBatchedIndices.size());
-		if (dataCount > params.maxDataCount)
+		if ((dataCount > params.maxDataCount ||
+			currBatchedVertices.size() + vertices.size() > maxVertices) &&
+			!currBatchedVertices.empty())
 		{
 			flush();
-			add(vertices, indices);
 		}
 
 		// Indices
-		for (const uint16_t index : indices)
+		const size_t baseVertex = currBatchedVertices.size();
+		for (const T index : indices)
 		{
-			currBatchedIndices.push_back(
-				static_cast<uint16_t>(currBatchedVertices.size()) + index);
+			currBatchedIndices.push_back(static_cast<uint16_t>(baseVertex + index));
 		}
 
 		// Vertices
@@ -56,7 +96,30 @@ namespace core
 	void Batch::add(const ref<Mesh>& mesh)
 	{
 		ASSERT(mesh, "Mesh is invalid");
+		if (!mesh->hasCpuData())
+		{
+			Logger::logError("Mesh can't be batched, it was created without keepCpuData");
+			return;
+		}
 		
+		// Meshes whose texture shares an atlas page with the batch material
+		// are merged by baking their region into the texture coordinates
+		const AtlasRegion* region = mesh->getMaterial() ?
+			mesh->getMaterial()->getBaseColorRegion() : nullptr;
+		if (region && material && !material->getBaseColorRegion() &&
+			mesh->getMaterial()->getBaseColorMap() == material->getBaseColorMap())
+		{
+			remappedVertices.assign(mesh->getVertices().begin(),
+				mesh->getVertices().end());
+			for (MeshVertex& vertex : remappedVertices)
+			{
+				vertex.texCoord = region->remap(vertex.texCoord);
+			}
+
+			add(remappedVertices, mesh->getIndices());
+			return;
+		}
+
 		if (mesh->getMaterial() != material)
 		{
 			Logger::logWarn("Overwriting mesh material to batch material");
@@ -67,14 +130,22 @@ namespace core
 
 	void Batch::flush()
 	{
-		const ref<Mesh> batchedMesh = Mesh::create(currBatchedVertices,
-			currBatchedIndices, material);
+		if (currBatchedVertices.empty())
+		{
+			return;
+		}
+
+		const size_t vertexCount = currBatchedVertices.size();
+		const size_t indexCount = currBatchedIndices.size();
+
+		// The batch buffers are handed over to the mesh without copying
+		const ref<Mesh> batchedMesh = Mesh::create(std::move(currBatchedVertices),
+			std::move(currBatchedIndices), material);
 		ASSERT(batchedMesh, "Mesh is invalid");
 		batchedMeshes.push_back(batchedMesh);
 
 		Logger::logInfo("Flushed batch, with %u batches, %u vertices and %u indices",
-			batchedMeshes.size(), currBatchedVertices.size(),
-			currBatchedIndices.size());
+			batchedMeshes.size(), vertexCount, indexCount);
 
 		currBatchedVertices.clear();
 		currBatchedIndices.clear();
@@ -5,22 +5,37 @@
 
 namespace core
 {
-	VertexBuffer::VertexBuffer(const BufferLayout& layout, const void* data,
-		const uint32_t& size)
+	const bgfx::Memory* shareMemory(const void* data, const uint32_t& size,
+		const ref<void>& owner)
+	{
+		return bgfx::makeRef(data, size, [](void*, void* userData)
+			{
+				delete static_cast<ref<void>*>(userData);
+			}, new ref<void>(owner));
+	}
+
+	VertexBuffer::VertexBuffer(const BufferLayout& layout,
+		const bgfx::Memory* memory)
 	{
 		bgfx::VertexLayout bgfxLayout;
 		bgfxLayout.begin();
 		for (auto& element : layout.getElements())
 		{
 			bgfxLayout.add(attribToBgfx(element.attrib), element.num,
-				attribTypeToBgfx(element.attribType));
+				attribTypeToBgfx(element.attribType), element.normalized);
 		}
 		bgfxLayout.end();
 
-		handle = bgfx::createVertexBuffer(bgfx::makeRef(data, size), bgfxLayout);
+		handle = bgfx::createVertexBuffer(memory, bgfxLayout);
 		ASSERT(bgfx::isValid(handle), "Created vertex buffer handle is invalid");
 	}
 
+	VertexBuffer::VertexBuffer(const BufferLayout& layout, const void* data,
+		const uint32_t& size)
+		: VertexBuffer(layout, bgfx::copy(data, size))
+	{
+	}
+
 	VertexBuffer::~VertexBuffer()
 	{
 		bgfx::destroy(handle);
@@ -119,20 +134,42 @@ namespace core
 		}
 	}
 
-	IndexBuffer::IndexBuffer(const void* data, const uint32_t& size)
+	IndexBuffer::IndexBuffer(const bgfx::Memory* memory, const bool& index32)
+		: index32(index32)
 	{
-		handle = bgfx::createIndexBuffer(bgfx::makeRef(data, size));
+		ASSERT(!index32 || (bgfx::getCaps()->supported & BGFX_CAPS_INDEX32),
+			"32 bit indices are unsupported by the renderer");
+
+		handle = bgfx::createIndexBuffer(memory,
+			index32 ? BGFX_BUFFER_INDEX32 : BGFX_BUFFER_NONE);
 		ASSERT(bgfx::isValid(handle), "Created index buffer handle is invalid");
 	}
 
+	IndexBuffer::IndexBuffer(const void* data, const uint32_t& size,
+		const bool& index32)
+		: IndexBuffer(bgfx::copy(data, size), index32)
+	{
+	}
+
 	IndexBuffer::~IndexBuffer()
 	{
 		bgfx::destroy(handle);
 	}
 
-	ref<IndexBuffer> IndexBuffer::create(const void* data, const uint32_t& size)
+	ref<IndexBuffer> IndexBuffer::create(const void* data, const uint32_t& size,
+		const bool& index32)
+	{
+		return makeRef<IndexBuffer>(data, size, index32);
+	}
+
+	ref<IndexBuffer> IndexBuffer::create(std::vector<uint16_t>&& indices)
+	{
+		return makeRef<IndexBuffer>(moveToMemory(std::move(indices)));
+	}
+
+	ref<IndexBuffer> IndexBuffer::create(std::vector<uint32_t>&& indices)
 	{
-		return makeRef<IndexBuffer>(data, size);
+		return makeRef<IndexBuffer>(moveToMemory(std::move(indices)), true);
 	}
 
 	VertexArray::VertexArray(const ref<VertexBuffer>& vertexBuffer,
@@ -26,6 +26,7 @@ namespace core
 {
 	Camera::Camera(const CameraParams& params)
 		: params(params), view(glm::mat4(1.0f)), proj(glm::mat4(1.0f))
+		, viewProj(glm::mat4(1.0f)), frustum()
 	{
 		recalculate();
 	}
@@ -38,6 +39,11 @@ namespace core
 
 		bx::mtxProj(&proj[0][0], params.fov, params.width / params.height,
 			params.clipNear, params.clipFar, bgfx::getCaps()->homogeneousDepth);
+
+		// World space frustum planes used for culling
+		viewProj = proj * view;
+		frustum = math::extractFrustum(viewProj,
+			bgfx::getCaps()->homogeneousDepth);
 	}
 
 	ref<Camera> Camera::create(const CameraParams& params)
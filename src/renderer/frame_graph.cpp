@@ -0,0 +1,365 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include "defines.hpp"
+#include "renderer/frame_graph.hpp"
+#include "renderer/render_target_pool.hpp"
+#include "debug/logger.hpp"
+
+namespace core
+{
+	/*
+	 * Transient textures can share memory if they would have been created
+	 * identically
+	 */
+	static bool isCompatible(const Texture2DParams& a, const Texture2DParams& b)
+	{
+		return a.format == b.format && a.width == b.width &&
+			a.height == b.height && a.hasMips == b.hasMips &&
+			a.nearest == b.nearest && a.stretch == b.stretch &&
+			a.compare == b.compare;
+	}
+
+	FrameGraphBuilder::FrameGraphBuilder(FrameGraph& graph, const uint32_t& pass)
+		: graph(graph), pass(pass)
+	{
+	}
+
+	FrameGraphTexture FrameGraphBuilder::create(const std::string& name,
+		const Texture2DParams& params)
+	{
+		ASSERT(params.width > 0 && params.height > 0, "Transient texture has no size");
+
+		FrameGraph::Resource resource;
+		resource.name = name;
+		resource.params = params;
+		resource.params.isRenderTarget = true;
+		graph.resources.push_back(std::move(resource));
+
+		return { static_cast<uint32_t>(graph.resources.size() - 1) };
+	}
+
+	FrameGraphTexture FrameGraphBuilder::read(const FrameGraphTexture& texture)
+	{
+		ASSERT(texture.id < graph.resources.size(), "Frame graph texture is invalid");
+		graph.passes[pass].reads.push_back(texture.id);
+		return texture;
+	}
+
+	FrameGraphTexture FrameGraphBuilder::write(const FrameGraphTexture& texture)
+	{
+		ASSERT(texture.id < graph.resources.size(), "Frame graph texture is invalid");
+		graph.passes[pass].writes.push_back(texture.id);
+		return texture;
+	}
+
+	void FrameGraphBuilder::writeBackbuffer()
+	{
+		graph.passes[pass].backbuffer = true;
+	}
+
+	void FrameGraphBuilder::setSideEffect()
+	{
+		graph.passes[pass].sideEffect = true;
+	}
+
+	ref<Texture2D> FrameGraphPass::getTexture(const FrameGraphTexture& texture) const
+	{
+		ASSERT(texture.id < graph->resources.size(), "Frame graph texture is invalid");
+		const FrameGraph::Resource& resource = graph->resources[texture.id];
+		if (resource.imported)
+		{
+			return resource.imported;
+		}
+		return (resource.physical != UINT32_MAX) ?
+			graph->physicalTextures[resource.physical].texture : nullptr;
+	}
+
+	FrameGraph::FrameGraph(const FrameGraphParams& params)
+		: params(params), executedCount(0), culledCount(0)
+	{
+	}
+
+	void FrameGraph::addPass(const std::string& name,
+		const std::function<void(FrameGraphBuilder&)>& setup,
+		std::function<void(const FrameGraphPass&)> execute)
+	{
+		FrameGraphPass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		pass.graph = this;
+		passes.push_back(std::move(pass));
+
+		FrameGraphBuilder builder(*this, static_cast<uint32_t>(passes.size() - 1));
+		setup(builder);
+	}
+
+	FrameGraphTexture FrameGraph::importTexture(const std::string& name,
+		const ref<Texture2D>& texture)
+	{
+		ASSERT(texture, "Imported texture is null");
+
+		Resource resource;
+		resource.name = name;
+		resource.params = texture->getParams();
+		resource.imported = texture;
+		resources.push_back(std::move(resource));
+
+		return { static_cast<uint32_t>(resources.size() - 1) };
+	}
+
+	void FrameGraph::execute(const uint32_t& width, const uint32_t& height)
+	{
+		std::vector<uint32_t> order;
+		cullPasses(order);
+		allocateTextures(order);
+
+		// Framebuffers used last frame are kept if they are used again
+		std::swap(framebuffers, unusedFramebuffers);
+		framebuffers.clear();
+
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			FrameGraphPass& pass = passes[order[i]];
+			PassParams& passParams = pass.passParams;
+			passParams.id = static_cast<uint16_t>(params.firstViewID + i);
+			passParams.framebuffer = pass.backbuffer ? nullptr : getFramebuffer(pass);
+
+			if (pass.backbuffer || pass.writes.empty())
+			{
+				passParams.width = width;
+				passParams.height = height;
+			}
+			else
+			{
+				const Texture2DParams& target = resources[pass.writes.front()].params;
+				passParams.width = target.width;
+				passParams.height = target.height;
+			}
+
+			if (pass.execute)
+			{
+				pass.execute(pass);
+			}
+		}
+		unusedFramebuffers.clear();
+
+		executedCount = static_cast<uint32_t>(order.size());
+		culledCount = static_cast<uint32_t>(passes.size() - order.size());
+		reset();
+	}
+
+	uint32_t FrameGraph::getPhysicalTextureCount() const
+	{
+		return static_cast<uint32_t>(physicalTextures.size());
+	}
+
+	/*
+	 * Walks the passes backwards keeping those with side effects and those
+	 * writing something a kept pass reads. A write without a read replaces
+	 * the texture, so earlier writers are only kept for later readers
+	 */
+	void FrameGraph::cullPasses(std::vector<uint32_t>& outPasses) const
+	{
+		std::vector<uint8_t> live(resources.size(), 0);
+		std::vector<uint8_t> keep(passes.size(), 0);
+
+		for (uint32_t p = static_cast<uint32_t>(passes.size()); p-- > 0; )
+		{
+			const FrameGraphPass& pass = passes[p];
+
+			bool needed = pass.backbuffer || pass.sideEffect;
+			for (const uint32_t write : pass.writes)
+			{
+				needed |= live[write] || resources[write].imported != nullptr;
+			}
+			if (!needed)
+			{
+				continue;
+			}
+
+			keep[p] = 1;
+			for (const uint32_t write : pass.writes)
+			{
+				live[write] = 0;
+			}
+			for (const uint32_t read : pass.reads)
+			{
+				live[read] = 1;
+			}
+		}
+
+		for (uint32_t p = 0; p < passes.size(); p++)
+		{
+			if (keep[p])
+			{
+				outPasses.push_back(p);
+			}
+		}
+
+	#ifdef _DEBUG
+		for (uint32_t r = 0; r < resources.size(); r++)
+		{
+			if (live[r] && !resources[r].imported)
+			{
+				Logger::logWarn("Frame graph texture %s is read before it is written",
+					resources[r].name.c_str());
+			}
+		}
+	#endif
+	}
+
+	/*
+	 * Gives every transient texture a render target for the passes using
+	 * it. Targets are handed to a later texture once their last pass is
+	 * done, targets left over from the last frame are reused first
+	 */
+	void FrameGraph::allocateTextures(const std::vector<uint32_t>& order)
+	{
+		for (Resource& resource : resources)
+		{
+			resource.physical = UINT32_MAX;
+			resource.firstPass = UINT32_MAX;
+			resource.lastPass = 0;
+		}
+
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			const FrameGraphPass& pass = passes[order[i]];
+			for (const std::vector<uint32_t>* list : { &pass.reads, &pass.writes })
+			{
+				for (const uint32_t id : *list)
+				{
+					resources[id].firstPass = std::min(resources[id].firstPass, i);
+					resources[id].lastPass = std::max(resources[id].lastPass, i);
+				}
+			}
+		}
+
+		for (PhysicalTexture& physical : physicalTextures)
+		{
+			physical.used = false;
+		}
+
+		// Resources are created in pass order, so first uses come in order
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			for (uint32_t id = 0; id < resources.size(); id++)
+			{
+				Resource& resource = resources[id];
+				if (resource.imported || resource.firstPass != i)
+				{
+					continue;
+				}
+
+				for (uint32_t t = 0; t < physicalTextures.size(); t++)
+				{
+					PhysicalTexture& physical = physicalTextures[t];
+					if ((!physical.used || physical.lastPass < i) &&
+						isCompatible(physical.texture->getParams(), resource.params))
+					{
+						resource.physical = t;
+						break;
+					}
+				}
+
+				if (resource.physical == UINT32_MAX)
+				{
+					// Targets dropped below go back to the pool, so a graph
+					// that changes shape reuses them
+					physicalTextures.push_back({ RenderTargetPool::isInitialized() ?
+						RenderTargetPool::acquire(resource.params) :
+						Texture2D::create(nullptr, resource.params) });
+					resource.physical = static_cast<uint32_t>(
+						physicalTextures.size() - 1);
+				}
+
+				PhysicalTexture& physical = physicalTextures[resource.physical];
+				physical.used = true;
+				physical.lastPass = resource.lastPass;
+			}
+		}
+
+		// Drop render targets nothing needs anymore, remapping the others
+		uint32_t count = 0;
+		std::vector<uint32_t> remap(physicalTextures.size(), UINT32_MAX);
+		for (uint32_t t = 0; t < physicalTextures.size(); t++)
+		{
+			if (physicalTextures[t].used)
+			{
+				remap[t] = count;
+				physicalTextures[count++] = std::move(physicalTextures[t]);
+			}
+		}
+		physicalTextures.resize(count);
+
+		for (Resource& resource : resources)
+		{
+			if (resource.physical != UINT32_MAX)
+			{
+				resource.physical = remap[resource.physical];
+			}
+		}
+	}
+
+	/*
+	 * Framebuffer with the pass's written textures attached in order,
+	 * cached by the texture handles
+	 */
+	ref<Framebuffer> FrameGraph::getFramebuffer(const FrameGraphPass& pass)
+	{
+		std::vector<ref<Texture2D>> textures;
+		std::vector<uint16_t> handles;
+		for (const uint32_t write : pass.writes)
+		{
+			textures.push_back(pass.getTexture({ write }));
+			handles.push_back(textures.back()->handle.idx);
+		}
+
+		if (textures.empty())
+		{
+			return nullptr;
+		}
+
+		const StringID key(hashFNV1a(reinterpret_cast<const char*>(handles.data()),
+			handles.size() * sizeof(uint16_t)));
+
+		if (const ref<Framebuffer>* framebuffer = framebuffers.find(key))
+		{
+			return *framebuffer;
+		}
+
+		ref<Framebuffer>* previous = unusedFramebuffers.find(key);
+		ref<Framebuffer> framebuffer = previous ? std::move(*previous) :
+			Framebuffer::create(textures);
+		framebuffers[key] = framebuffer;
+		return framebuffer;
+	}
+
+	void FrameGraph::reset()
+	{
+		passes.clear();
+		resources.clear();
+	}
+
+	ref<FrameGraph> FrameGraph::create(const FrameGraphParams& params)
+	{
+		return makeRef<FrameGraph>(params);
+	}
+}
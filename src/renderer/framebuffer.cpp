@@ -3,6 +3,7 @@
 #include <bx/bx.h>
 
 #include "renderer/framebuffer.hpp"
+#include "renderer/render_target_pool.hpp"
 #include "defines.hpp"
 #include "debug.hpp"
 
@@ -22,7 +23,9 @@ namespace core
 		// Create framebuffer handle with texture handles
 		if (textureData)
 		{
-			handle = bgfx::createFrameBuffer(texturesHandles.size(), textureData, true);
+			// The textures are destroyed by their Texture2D, which the
+			// framebuffer keeps alive
+			handle = bgfx::createFrameBuffer(texturesHandles.size(), textureData, false);
 		}
 
 		if (bgfx::isValid(handle))
@@ -33,11 +36,24 @@ namespace core
 
 	Framebuffer::~Framebuffer()
 	{
-		bgfx::destroy(handle); 
+		if (bgfx::isValid(handle))
+		{
+			bgfx::destroy(handle);
+		}
 	}
 
 	ref<Framebuffer> Framebuffer::create(const std::vector<ref<Texture2D>>& textures)
 	{
 		return makeRef<Framebuffer>(textures);
 	}
+
+	ref<Framebuffer> Framebuffer::createPooled(const std::vector<Texture2DParams>& attachments)
+	{
+		std::vector<ref<Texture2D>> textures;
+		for (const Texture2DParams& attachment : attachments)
+		{
+			textures.push_back(RenderTargetPool::acquire(attachment));
+		}
+		return makeRef<Framebuffer>(textures);
+	}
 }
\ No newline at end of file
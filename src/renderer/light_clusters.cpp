@@ -0,0 +1,341 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include "defines.hpp"
+#include "jobs/job_system.hpp"
+#include "renderer/light_clusters.hpp"
+#include "renderer/uniform_registry.hpp"
+
+namespace core
+{
+	static constexpr uint32_t lightsPerRow = 256;
+	static constexpr uint32_t texelsPerLight = 4;
+	static constexpr uint32_t indicesPerRow = 1024;
+
+	LightClusters::LightClusters(const LightClustersParams& params)
+		: params(params)
+		, s_lights(BGFX_INVALID_HANDLE), s_clusters(BGFX_INVALID_HANDLE)
+		, s_lightIndices(BGFX_INVALID_HANDLE), u_clusterGrid(BGFX_INVALID_HANDLE)
+		, u_clusterDepth(BGFX_INVALID_HANDLE)
+		, clusterGrid(0.0f), clusterDepth(0.0f), lightCount(0), indexCount(0)
+	{
+		ASSERT(params.gridX > 0 && params.gridY > 0 && params.gridZ > 0,
+			"Light cluster grid is empty");
+
+		// Data textures, fetched by texel so no filtering
+		Texture2DParams textureParams;
+		textureParams.nearest = true;
+
+		textureParams.format = Texture2DFormat::RGBA32F;
+		textureParams.width = lightsPerRow * texelsPerLight;
+		textureParams.height = static_cast<uint16_t>(
+			(params.maxLights + lightsPerRow - 1) / lightsPerRow);
+		lightsTexture = Texture2D::create(nullptr, textureParams);
+
+		textureParams.format = Texture2DFormat::RG32F;
+		textureParams.width = params.gridX * params.gridY;
+		textureParams.height = params.gridZ;
+		clustersTexture = Texture2D::create(nullptr, textureParams);
+
+		textureParams.format = Texture2DFormat::R32F;
+		textureParams.width = indicesPerRow;
+		textureParams.height = static_cast<uint16_t>(
+			(params.maxLightIndices + indicesPerRow - 1) / indicesPerRow);
+		indicesTexture = Texture2D::create(nullptr, textureParams);
+
+		// Uniforms
+		s_lights = UniformRegistry::get("s_lights", bgfx::UniformType::Sampler);
+		s_clusters = UniformRegistry::get("s_clusters", bgfx::UniformType::Sampler);
+		s_lightIndices = UniformRegistry::get("s_lightIndices", bgfx::UniformType::Sampler);
+		u_clusterGrid = UniformRegistry::get("u_clusterGrid", bgfx::UniformType::Vec4);
+		u_clusterDepth = UniformRegistry::get("u_clusterDepth", bgfx::UniformType::Vec4);
+
+		clusterTexels.resize(static_cast<size_t>(params.gridX) * params.gridY *
+			params.gridZ * 2);
+		sliceCandidates.resize(params.gridZ);
+		sliceCounts.resize(params.gridZ);
+		sliceIndices.resize(params.gridZ);
+	}
+
+	void LightClusters::build(const std::vector<ref<Light>>& lights,
+		const Camera& camera)
+	{
+		const CameraParams& cameraParams = camera.getParams();
+		const glm::mat4& view = camera.getViewMatrix();
+		const glm::mat4& proj = camera.getProjectionMatrix();
+
+		const uint32_t gridX = params.gridX;
+		const uint32_t gridY = params.gridY;
+		const uint32_t gridZ = params.gridZ;
+		const uint32_t tilesPerSlice = gridX * gridY;
+
+		// Exponential slices, slice = log(z) * scale - bias
+		const float zNear = cameraParams.clipNear;
+		const float zFar = cameraParams.clipFar;
+		const float scale = static_cast<float>(gridZ) / std::log(zFar / zNear);
+		const float bias = std::log(zNear) * scale;
+		const auto sliceOf = [&](float z)
+		{
+			const float slice = std::floor(std::log(std::max(z, zNear)) * scale - bias);
+			return static_cast<uint16_t>(std::clamp(slice, 0.0f,
+				static_cast<float>(gridZ - 1)));
+		};
+
+		// Screen tile of a point in normalized device coordinates
+		const auto tileOf = [](float ndc, uint32_t count)
+		{
+			const float tile = std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(count));
+			return static_cast<uint16_t>(std::clamp(tile, 0.0f,
+				static_cast<float>(count - 1)));
+		};
+
+		// Conservative normalized device range of a sphere along one axis,
+		// a side leans the most towards the edge on the nearest depth if it
+		// is on that side of the view axis and on the farthest otherwise
+		const auto ndcRange = [](float center, float radius, float projScale,
+			float zMin, float zMax, float& outMin, float& outMax)
+		{
+			const float low = center - radius;
+			const float high = center + radius;
+			outMin = low * projScale / (low < 0.0f ? zMin : zMax);
+			outMax = high * projScale / (high > 0.0f ? zMin : zMax);
+		};
+
+		// Visible lights, packed in the order they are given
+		binned.clear();
+		lightTexels.clear();
+		for (const ref<Light>& light : lights)
+		{
+			const glm::vec3 extents = glm::vec3(light->range);
+			if (!math::isVisible(camera.getFrustum(),
+				AABB(light->position - extents, light->position + extents)))
+			{
+				continue;
+			}
+
+			if (binned.size() >= params.maxLights)
+			{
+				Logger::logWarn("Too many visible lights, only %u are shaded",
+					params.maxLights);
+				break;
+			}
+
+			BinnedLight entry;
+			entry.center = glm::vec3(view * glm::vec4(light->position, 1.0f));
+			entry.radius = light->range;
+
+			const float zMin = entry.center.z - entry.radius;
+			const float zMax = entry.center.z + entry.radius;
+			if (zMax < zNear || zMin > zFar)
+			{
+				continue;
+			}
+			entry.minZ = sliceOf(zMin);
+			entry.maxZ = sliceOf(zMax);
+
+			// Spheres crossing the near plane can cover any tile
+			entry.minX = 0;
+			entry.maxX = static_cast<uint16_t>(gridX - 1);
+			entry.minY = 0;
+			entry.maxY = static_cast<uint16_t>(gridY - 1);
+			if (zMin > zNear)
+			{
+				float ndcMin, ndcMax;
+				ndcRange(entry.center.x, entry.radius, proj[0][0], zMin, zMax,
+					ndcMin, ndcMax);
+				entry.minX = tileOf(ndcMin, gridX);
+				entry.maxX = tileOf(ndcMax, gridX);
+
+				ndcRange(entry.center.y, entry.radius, proj[1][1], zMin, zMax,
+					ndcMin, ndcMax);
+				entry.minY = tileOf(ndcMin, gridY);
+				entry.maxY = tileOf(ndcMax, gridY);
+			}
+			binned.push_back(entry);
+
+			const bool isSpot = light->type == LightType::Spot;
+			lightTexels.push_back(glm::vec4(light->position, light->range));
+			lightTexels.push_back(glm::vec4(light->color * light->intensity,
+				isSpot ? 1.0f : 0.0f));
+			lightTexels.push_back(glm::vec4(glm::normalize(light->direction),
+				std::cos(light->outerAngle)));
+			lightTexels.push_back(glm::vec4(std::cos(light->innerAngle),
+				0.0f, 0.0f, 0.0f));
+		}
+		lightCount = static_cast<uint32_t>(binned.size());
+
+		// Bin every slice on its own, a froxel keeps the lights whose sphere
+		// touches its view space box
+		const float ratio = zFar / zNear;
+		JobSystem::parallelFor(gridZ, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t z = begin; z < end; z++)
+			{
+				std::vector<uint32_t>& candidates = sliceCandidates[z];
+				std::vector<uint32_t>& counts = sliceCounts[z];
+				std::vector<uint32_t>& indices = sliceIndices[z];
+				candidates.clear();
+				counts.assign(tilesPerSlice, 0);
+				indices.clear();
+
+				for (uint32_t i = 0; i < lightCount; i++)
+				{
+					if (binned[i].minZ <= z && z <= binned[i].maxZ)
+					{
+						candidates.push_back(i);
+					}
+				}
+				if (candidates.empty())
+				{
+					continue;
+				}
+
+				const float sliceNear = zNear * std::pow(ratio,
+					static_cast<float>(z) / static_cast<float>(gridZ));
+				const float sliceFar = zNear * std::pow(ratio,
+					static_cast<float>(z + 1) / static_cast<float>(gridZ));
+
+				for (uint32_t y = 0; y < gridY; y++)
+				{
+					const float ndcBottom = static_cast<float>(y) / gridY * 2.0f - 1.0f;
+					const float ndcTop = static_cast<float>(y + 1) / gridY * 2.0f - 1.0f;
+					const float boxBottom = std::min(ndcBottom * sliceNear,
+						ndcBottom * sliceFar) / proj[1][1];
+					const float boxTop = std::max(ndcTop * sliceNear,
+						ndcTop * sliceFar) / proj[1][1];
+
+					for (uint32_t x = 0; x < gridX; x++)
+					{
+						const float ndcLeft = static_cast<float>(x) / gridX * 2.0f - 1.0f;
+						const float ndcRight = static_cast<float>(x + 1) / gridX * 2.0f - 1.0f;
+						const glm::vec3 boxMin(std::min(ndcLeft * sliceNear,
+							ndcLeft * sliceFar) / proj[0][0], boxBottom, sliceNear);
+						const glm::vec3 boxMax(std::max(ndcRight * sliceNear,
+							ndcRight * sliceFar) / proj[0][0], boxTop, sliceFar);
+
+						uint32_t& count = counts[x + y * gridX];
+						for (const uint32_t i : candidates)
+						{
+							const BinnedLight& light = binned[i];
+							if (x < light.minX || x > light.maxX ||
+								y < light.minY || y > light.maxY)
+							{
+								continue;
+							}
+
+							const glm::vec3 closest = glm::clamp(light.center,
+								boxMin, boxMax);
+							const glm::vec3 offset = closest - light.center;
+							if (glm::dot(offset, offset) <= light.radius * light.radius)
+							{
+								indices.push_back(i);
+								count++;
+							}
+						}
+					}
+				}
+			}
+		});
+
+		// Concatenate the slices in order so the lists do not depend on
+		// which thread binned them
+		indexTexels.clear();
+		bool overflowed = false;
+		for (uint32_t z = 0; z < gridZ; z++)
+		{
+			uint32_t read = 0;
+			for (uint32_t tile = 0; tile < tilesPerSlice; tile++)
+			{
+				uint32_t count = sliceCounts[z][tile];
+				const uint32_t offset = static_cast<uint32_t>(indexTexels.size());
+				if (offset + count > params.maxLightIndices)
+				{
+					overflowed = true;
+				}
+				const uint32_t kept = std::min(count,
+					params.maxLightIndices - offset);
+
+				for (uint32_t i = 0; i < kept; i++)
+				{
+					indexTexels.push_back(static_cast<float>(sliceIndices[z][read + i]));
+				}
+				read += count;
+
+				const size_t cluster = (static_cast<size_t>(z) * tilesPerSlice + tile) * 2;
+				clusterTexels[cluster + 0] = static_cast<float>(offset);
+				clusterTexels[cluster + 1] = static_cast<float>(kept);
+			}
+		}
+		indexCount = static_cast<uint32_t>(indexTexels.size());
+
+		if (overflowed)
+		{
+			Logger::logWarn("Light cluster index list is full, lights are missing "
+				"from some clusters");
+		}
+
+		// Upload, only the rows that are used
+		if (lightCount > 0)
+		{
+			const uint32_t rows = (lightCount + lightsPerRow - 1) / lightsPerRow;
+			lightTexels.resize(static_cast<size_t>(rows) * lightsPerRow * texelsPerLight,
+				glm::vec4(0.0f));
+			bgfx::updateTexture2D(lightsTexture->handle, 0, 0, 0, 0,
+				static_cast<uint16_t>(lightsPerRow * texelsPerLight),
+				static_cast<uint16_t>(rows), bgfx::copy(lightTexels.data(),
+					static_cast<uint32_t>(lightTexels.size() * sizeof(glm::vec4))));
+		}
+
+		bgfx::updateTexture2D(clustersTexture->handle, 0, 0, 0, 0,
+			static_cast<uint16_t>(tilesPerSlice), static_cast<uint16_t>(gridZ),
+			bgfx::copy(clusterTexels.data(),
+				static_cast<uint32_t>(clusterTexels.size() * sizeof(float))));
+
+		if (indexCount > 0)
+		{
+			const uint32_t rows = (indexCount + indicesPerRow - 1) / indicesPerRow;
+			indexTexels.resize(static_cast<size_t>(rows) * indicesPerRow, 0.0f);
+			bgfx::updateTexture2D(indicesTexture->handle, 0, 0, 0, 0,
+				static_cast<uint16_t>(indicesPerRow), static_cast<uint16_t>(rows),
+				bgfx::copy(indexTexels.data(),
+					static_cast<uint32_t>(indexTexels.size() * sizeof(float))));
+		}
+
+		clusterGrid = glm::vec4(gridX, gridY, gridZ, lightCount);
+		clusterDepth = glm::vec4(zNear, zFar, scale, bias);
+	}
+
+	void LightClusters::bind(bgfx::Encoder* encoder, const bool& uploadValues) const
+	{
+		encoder->setTexture(1, s_lights, lightsTexture->handle);
+		encoder->setTexture(2, s_clusters, clustersTexture->handle);
+		encoder->setTexture(3, s_lightIndices, indicesTexture->handle);
+
+		if (uploadValues)
+		{
+			encoder->setUniform(u_clusterGrid, &clusterGrid);
+			encoder->setUniform(u_clusterDepth, &clusterDepth);
+		}
+	}
+
+	ref<LightClusters> LightClusters::create(const LightClustersParams& params)
+	{
+		return makeRef<LightClusters>(params);
+	}
+}
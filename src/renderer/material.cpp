@@ -19,63 +19,141 @@
 #include "defines.hpp"
 #include "renderer/material.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/uniform_registry.hpp"
 
 namespace core
 {
 	Material::Material(const MaterialParams& params)
-		: params(params)
+		: params(params), id(0), revision(0), state(0)
+		, shaderName("uber"), shaderID(shaderName), shaderFeatures(0)
 		, baseColorMap(nullptr), u_BaseColorMap(BGFX_INVALID_HANDLE)
+		, baseColorRegion(0.0f, 0.0f, 1.0f, 1.0f), u_BaseColorRegion(BGFX_INVALID_HANDLE)
 		, baseColorFactor(glm::vec4(CORE_BIG_NUMBER)), u_BaseColorFactor(BGFX_INVALID_HANDLE)
 	{
-		shader = Renderer::getShaderManager()->get("uber");
-		ASSERT(shader, "Shader is null");
+		// Unique id used when sorting submissions by material
+		static uint16_t materialCount = 0;
+		id = materialCount++;
+
+		updateShader();
+		markDirty();
 			
-		// Uniforms
-		u_BaseColorMap = bgfx::createUniform("u_BaseColorMap",
+		// Uniforms, shared by every material
+		u_BaseColorMap = UniformRegistry::get("u_BaseColorMap",
 			bgfx::UniformType::Sampler, 2);
-		u_BaseColorFactor = bgfx::createUniform("u_BaseColorFactor",
+		u_BaseColorFactor = UniformRegistry::get("u_BaseColorFactor",
 			bgfx::UniformType::Vec4);
+		u_BaseColorRegion = UniformRegistry::get("u_BaseColorRegion",
+			bgfx::UniformType::Vec4);
+
+		// States, fixed by the params
+		const uint64_t defaultState = BGFX_STATE_WRITE_RGB
+			| BGFX_STATE_WRITE_A
+			| BGFX_STATE_WRITE_Z
+			| BGFX_STATE_DEPTH_TEST_LESS;
+
+		const uint64_t twoSided    = (params.twoSided) ?
+			0 : BGFX_STATE_CULL_CCW;
+
+		const uint64_t translucent = (params.blendType == BlendType::Translucent) ?
+			BGFX_STATE_BLEND_ALPHA     : 0;
+
+		state = defaultState | twoSided | translucent;
 	}
 
 	void Material::addTexture(const ref<Texture2D>& texture,
-		const std::string& name)
+		const StringID& name)
 	{
 		textures[name] = texture;
+		atlasRegions.erase(name);
+		markDirty();
+	}
+
+	void Material::addTexture(const ref<TextureAtlas>& atlas,
+		const AtlasRegion& region, const StringID& name)
+	{
+		ASSERT(atlas && region.page < atlas->getPageCount(), "Atlas region is invalid");
+		textures[name] = atlas->getPage(region.page);
+		atlasRegions[name] = region;
+		markDirty();
+	}
+
+	const AtlasRegion* Material::getBaseColorRegion() const
+	{
+		return baseColorMap ? atlasRegions.find(baseColorMapName) : nullptr;
 	}
 
-	void Material::setBasecolor(const std::string& textureName)
+	void Material::setBasecolor(const StringID& textureName)
 	{
-		ASSERT(!textureName.empty(), "Texture name is empty");
-		baseColorMap = textures[textureName];
+		const ref<Texture2D>* texture = textures.find(textureName);
+		ASSERT(texture, "Texture is not added to the material");
+		baseColorMap = texture ? *texture : nullptr;
+		baseColorMapName = textureName;
+		updateShader();
+		markDirty();
 	}
 
 	void Material::setBasecolor(const glm::vec4& color)
 	{
 		baseColorFactor = color;
+		updateShader();
+		markDirty();
 	}
 
-	void Material::updateUniforms() const
+	void Material::markDirty()
 	{
-		// Base Color	
+		static uint64_t revisionCount = 0;
+		revision = ++revisionCount;
+
+		const AtlasRegion* region = getBaseColorRegion();
+		baseColorRegion = region ? glm::vec4(region->uvOffset, region->uvScale) :
+			glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+
+	void Material::updateShader()
+	{
+		shaderFeatures = ShaderFeatureNone;
+		if (params.shadingType == ShadingType::Unlit)
+		{
+			shaderFeatures |= ShaderFeatureUnlit;
+		}
 		if ((baseColorFactor.w >= CORE_BIG_NUMBER) && baseColorMap)
 		{
-			bgfx::setTexture(0, u_BaseColorMap, baseColorMap->handle);
+			shaderFeatures |= ShaderFeatureBaseColorMap;
+		}
+		if (params.twoSided)
+		{
+			shaderFeatures |= ShaderFeatureTwoSided;
+		}
+		if (params.blendType == BlendType::Translucent)
+		{
+			shaderFeatures |= ShaderFeatureTranslucent;
 		}
-		bgfx::setUniform(u_BaseColorFactor, &baseColorFactor); // Set it to default factor when texture is valid
 
-		// States
-		const uint64_t default = BGFX_STATE_WRITE_RGB
-			| BGFX_STATE_WRITE_A
-			| BGFX_STATE_WRITE_Z
-			| BGFX_STATE_DEPTH_TEST_LESS;
+		shader = Renderer::getShaderManager()->getVariant(shaderName, shaderFeatures);
+		ASSERT(shader, "Shader is null");
+	}
 
-		const uint64_t twoSided    = (params.twoSided) ?
-			0 : BGFX_STATE_CULL_CCW;
+	void Material::updateUniforms(bgfx::Encoder* encoder,
+		const bool& uploadValues) const
+	{
+		// Base Color	
+		const bool hasBaseColorMap = (baseColorFactor.w >= CORE_BIG_NUMBER) && baseColorMap;
+		if (hasBaseColorMap)
+		{
+			encoder->setTexture(0, u_BaseColorMap, baseColorMap->handle);
+		}
 
-		const uint64_t translucent = (params.blendType == BlendType::Translucent) ?
-			BGFX_STATE_BLEND_ALPHA     : 0;
-									
-		bgfx::setState(default | twoSided | translucent);
+		if (uploadValues)
+		{
+			if (hasBaseColorMap)
+			{
+				encoder->setUniform(u_BaseColorRegion, &baseColorRegion);
+			}
+			encoder->setUniform(u_BaseColorFactor, &baseColorFactor); // Set it to default factor when texture is valid
+		}
+
+		// States
+		encoder->setState(state);
 	}
 
 	ref<Material> Material::create(const MaterialParams& params)
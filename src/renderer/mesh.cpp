@@ -23,49 +23,318 @@
 #include "renderer/mesh.hpp"
 #include "renderer/buffers.hpp"
 #include "renderer/vertex.hpp"
+#include "math/packing.hpp"
 
 namespace core
 {
+	static BufferLayout getLayout(const VertexFormat& format)
+	{
+		switch (format)
+		{
+		case VertexFormat::Packed:
+			return std::vector<BufferElement>
+			{
+				{ AttribType::Float, 3, Attrib::Position },
+				{ AttribType::Int16, 2, Attrib::Normal, true },
+				{ AttribType::Uint10, 4, Attrib::Tangent, true },
+				{ AttribType::Half, 2, Attrib::TexCoord0 }
+			};
+
+		case VertexFormat::Quantized:
+			return std::vector<BufferElement>
+			{
+				{ AttribType::Int16, 4, Attrib::Position, true },
+				{ AttribType::Int16, 2, Attrib::Normal, true },
+				{ AttribType::Uint10, 4, Attrib::Tangent, true },
+				{ AttribType::Half, 2, Attrib::TexCoord0 }
+			};
+
+		default:
+			return std::vector<BufferElement>
+			{
+				{ AttribType::Float, 3, Attrib::Position },
+				{ AttribType::Float, 3, Attrib::Normal },
+				{ AttribType::Float, 3, Attrib::Tangent },
+				{ AttribType::Float, 3, Attrib::Bitangent },
+				{ AttribType::Float, 2, Attrib::TexCoord0 }
+			};
+		}
+	}
+
+	/*
+	 * Encodes everything but the position, shared by both packed formats
+	 */
+	template<typename T>
+	static void packAttributes(const MeshVertex& vertex, T& outVertex)
+	{
+		const glm::vec2 normal = math::octEncode(vertex.normal);
+		outVertex.normal[0] = math::packSnorm16(normal.x);
+		outVertex.normal[1] = math::packSnorm16(normal.y);
+
+		const float sign = glm::dot(glm::cross(vertex.normal, vertex.tangent),
+			vertex.biNormal) < 0.0f ? 0.0f : 1.0f;
+		const glm::vec2 tangent = math::octEncode(vertex.tangent) * 0.5f + 0.5f;
+		outVertex.tangent = math::packUnorm1010102(
+			glm::vec4(tangent.x, tangent.y, 0.0f, sign));
+
+		outVertex.texCoord[0] = math::packHalf(vertex.texCoord.x);
+		outVertex.texCoord[1] = math::packHalf(vertex.texCoord.y);
+	}
+
+	/*
+	 * Uploads 32 bit source indices, narrowed to 16 bit when every vertex
+	 * can be addressed with them. The indices are moved into bgfx unless
+	 * they are kept
+	 */
+	static ref<IndexBuffer> createIndexBuffer(std::vector<uint32_t>& indices,
+		const uint32_t vertexCount, const bool keepIndices)
+	{
+		if (vertexCount <= std::numeric_limits<uint16_t>::max() + 1)
+		{
+			std::vector<uint16_t> narrowed(indices.begin(), indices.end());
+			return IndexBuffer::create(std::move(narrowed));
+		}
+
+		if (!(bgfx::getCaps()->supported & BGFX_CAPS_INDEX32))
+		{
+			Logger::logError("Mesh with %u vertices needs 32 bit indices, which are unsupported. Split it with utils::splitMesh or batch it",
+				vertexCount);
+			return nullptr;
+		}
+
+		if (keepIndices)
+		{
+			return IndexBuffer::create(indices.data(),
+				static_cast<uint32_t>(indices.size() * sizeof(uint32_t)), true);
+		}
+
+		return IndexBuffer::create(std::move(indices));
+	}
+
+	/*
+	 * Packed formats need half and 10 bit vertex attributes
+	 */
+	static VertexFormat resolveVertexFormat(const VertexFormat& format)
+	{
+		constexpr uint64_t packedCaps = BGFX_CAPS_VERTEX_ATTRIB_HALF |
+			BGFX_CAPS_VERTEX_ATTRIB_UINT10;
+		if (format != VertexFormat::Float &&
+			(bgfx::getCaps()->supported & packedCaps) != packedCaps)
+		{
+			Logger::logWarn("Packed vertex formats are unsupported, using float vertices");
+			return VertexFormat::Float;
+		}
+
+		return format;
+	}
+
 	Mesh::Mesh(std::vector<MeshVertex> vertices, std::vector<uint16_t> indices,
-			const ref<Material>& material)
-		: material(material), vertices(std::move(vertices))
-		, indices(std::move(indices))
+			const ref<Material>& material, const MeshParams& params)
+		: params(params), material(material)
+		, vertexFormat(resolveVertexFormat(params.vertexFormat))
+		, vertexCount(static_cast<uint32_t>(vertices.size()))
+		, indexCount(static_cast<uint32_t>(indices.size()))
+	{
+		ASSERT(indexCount > 0, "Indices are empty");
+
+		ref<IndexBuffer> indexBuffer;
+		if (params.keepCpuData)
+		{
+			indexBuffer = IndexBuffer::create(indices.data(),
+				indexCount * sizeof(uint16_t));
+			this->indices.assign(indices.begin(), indices.end());
+		}
+		else
+		{
+			indexBuffer = IndexBuffer::create(std::move(indices));
+		}
+
+		initFromVector(std::move(vertices), indexBuffer);
+	}
+
+	Mesh::Mesh(std::vector<MeshVertex> vertices, std::vector<uint32_t> indices,
+			const ref<Material>& material, const MeshParams& params)
+		: params(params), material(material)
+		, vertexFormat(resolveVertexFormat(params.vertexFormat))
+		, vertexCount(static_cast<uint32_t>(vertices.size()))
+		, indexCount(static_cast<uint32_t>(indices.size()))
+	{
+		ASSERT(indexCount > 0, "Indices are empty");
+
+		const ref<IndexBuffer> indexBuffer = createIndexBuffer(indices,
+			vertexCount, params.keepCpuData);
+		if (params.keepCpuData)
+		{
+			this->indices = std::move(indices);
+		}
+
+		initFromVector(std::move(vertices), indexBuffer);
+	}
+
+	Mesh::Mesh(span<const MeshVertex> vertices, span<const uint8_t> indices,
+			const bool& index32, const AABB& bounds,
+			const BoundingSphere& boundingSphere, const ref<void>& owner,
+			const ref<Material>& material, const MeshParams& params)
+		: params(params), material(material)
+		, bounds(bounds), boundingSphere(boundingSphere)
+		, vertexFormat(resolveVertexFormat(params.vertexFormat))
+		, vertexCount(static_cast<uint32_t>(vertices.size()))
+		, indexCount(static_cast<uint32_t>(indices.size() /
+			(index32 ? sizeof(uint32_t) : sizeof(uint16_t))))
+	{
+		ASSERT(indexCount > 0, "Indices are empty");
+
+		const ref<IndexBuffer> indexBuffer = makeRef<IndexBuffer>(
+			shareMemory(indices.data(), static_cast<uint32_t>(indices.size()), owner),
+			index32);
+
+		if (params.keepCpuData)
+		{
+			this->indices.resize(indexCount);
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				this->indices[i] = index32 ?
+					reinterpret_cast<const uint32_t*>(indices.data())[i] :
+					reinterpret_cast<const uint16_t*>(indices.data())[i];
+			}
+			this->vertices.assign(vertices.begin(), vertices.end());
+		}
+
+		// Float vertices are uploaded straight from the owner's memory
+		const bgfx::Memory* vertexMemory = (vertexFormat == VertexFormat::Float) ?
+			shareMemory(vertices.data(), static_cast<uint32_t>(vertices.sizeBytes()), owner) :
+			nullptr;
+		init(vertices, vertexMemory, indexBuffer);
+	}
+
+	void Mesh::initFromVector(std::vector<MeshVertex>&& vertices,
+		const ref<IndexBuffer>& indexBuffer)
+	{
+		ASSERT(vertexCount > 0, "Vertices are empty");
+
+		// Bounds in mesh space, used for culling
+		bounds = math::computeAABB(&vertices[0].position, vertexCount,
+			sizeof(MeshVertex));
+		boundingSphere = math::computeBoundingSphere(&vertices[0].position,
+			vertexCount, sizeof(MeshVertex));
+
+		if (params.keepCpuData)
+		{
+			// bgfx gets its own copy, ours stays valid for the lifetime of the mesh
+			this->vertices = std::move(vertices);
+			init(this->vertices, nullptr, indexBuffer);
+		}
+		else if (vertexFormat == VertexFormat::Float)
+		{
+			// Hand the geometry over to bgfx, it is freed after upload. Moving
+			// the vector keeps its storage so the view stays valid
+			const span<const MeshVertex> view = vertices;
+			init(view, moveToMemory(std::move(vertices)), indexBuffer);
+		}
+		else
+		{
+			init(vertices, nullptr, indexBuffer);
+		}
+	}
+
+	void Mesh::init(span<const MeshVertex> vertices,
+		const bgfx::Memory* vertexMemory, const ref<IndexBuffer>& indexBuffer)
 	{
-		ASSERT(this->vertices.size() > 0, "Vertices are empty");
-		ASSERT(this->indices.size() > 0, "Indices are empty");
+		ASSERT(vertexCount > 0, "Vertices are empty");
+
+		// The index buffer could not be created, leave the mesh without a
+		// vertex array so create() can fail
+		if (!indexBuffer)
+		{
+			return;
+		}
 		
 		if (!material)
 		{
 			Logger::logWarn("Created mesh contains no material");
 		}
+
+		// Positions are quantized relative to the bounds, with a uniform
+		// scale so the decode matrix does not skew normals
+		decodeMatrix = glm::mat4(1.0f);
+		const glm::vec3 center = bounds.getCenter();
+		const glm::vec3 extents = bounds.getExtents();
+		float scale = glm::max(extents.x, glm::max(extents.y, extents.z));
+		scale = scale > CORE_VERY_SMALL_NUMBER ? scale : 1.0f;
+		if (vertexFormat == VertexFormat::Quantized)
+		{
+			decodeMatrix = glm::mat4(scale);
+			decodeMatrix[3] = glm::vec4(center, 1.0f);
+		}
+
+		const BufferLayout layout = getLayout(vertexFormat);
 		
-		std::vector<BufferElement> layout =
-		{
-			{ AttribType::Float, 3, Attrib::Position },
-			{ AttribType::Float, 3, Attrib::Normal },
-			{ AttribType::Float, 3, Attrib::Tangent },
-			{ AttribType::Float, 3, Attrib::Bitangent },
-			{ AttribType::Float, 2, Attrib::TexCoord0 }
-		};
-		
-		ref<VertexBuffer> vertexBuffer = VertexBuffer::create(layout, Mesh::vertices.data(),
-			static_cast<uint32_t>(Mesh::vertices.size()) * sizeof(MeshVertex));
+		ref<VertexBuffer> vertexBuffer;
+		if (vertexFormat == VertexFormat::Packed)
+		{
+			std::vector<PackedMeshVertex> packed(vertexCount);
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				packed[i].position = vertices[i].position;
+				packAttributes(vertices[i], packed[i]);
+			}
+			vertexBuffer = VertexBuffer::create(layout, std::move(packed));
+		}
+		else if (vertexFormat == VertexFormat::Quantized)
+		{
+			std::vector<QuantizedMeshVertex> quantized(vertexCount);
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const glm::vec3 position = (vertices[i].position - center) / scale;
+				quantized[i].position[0] = math::packSnorm16(position.x);
+				quantized[i].position[1] = math::packSnorm16(position.y);
+				quantized[i].position[2] = math::packSnorm16(position.z);
+				quantized[i].position[3] = 0;
+				packAttributes(vertices[i], quantized[i]);
+			}
+			vertexBuffer = VertexBuffer::create(layout, std::move(quantized));
+		}
+		else if (vertexMemory)
+		{
+			vertexBuffer = makeRef<VertexBuffer>(layout, vertexMemory);
+		}
+		else
+		{
+			vertexBuffer = VertexBuffer::create(layout, vertices.data(),
+				static_cast<uint32_t>(vertices.sizeBytes()));
+		}
 		ASSERT(vertexBuffer, "Invalid VertexBuffer");
-			
-		ref<IndexBuffer> indexBuffer = IndexBuffer::create(Mesh::indices.data(),
-			static_cast<uint32_t>(Mesh::indices.size()) * sizeof(uint16_t));
-		ASSERT(indexBuffer, "Invalid IndexBuffer");
 
 		vao = VertexArray::create(vertexBuffer, indexBuffer);
 		ASSERT(vao, "Invalid VertexArray");
 	}
 
-	ref<Mesh> Mesh::create(const std::vector<MeshVertex>& vertices,
-			const std::vector<uint16_t>& indices,
-			const ref<Material>& material)
+	ref<Mesh> Mesh::create(std::vector<MeshVertex> vertices,
+			std::vector<uint16_t> indices, const ref<Material>& material,
+			const MeshParams& params)
 	{
-		return makeRef<Mesh>(vertices, indices, material);
+		return makeRef<Mesh>(std::move(vertices), std::move(indices),
+			material, params);
 	}
+
+	ref<Mesh> Mesh::create(std::vector<MeshVertex> vertices,
+			std::vector<uint32_t> indices, const ref<Material>& material,
+			const MeshParams& params)
+	{
+		const ref<Mesh> mesh = makeRef<Mesh>(std::move(vertices),
+			std::move(indices), material, params);
+		return mesh->getVertexArray() ? mesh : nullptr;
+	}
+
+	ref<Mesh> Mesh::create(span<const MeshVertex> vertices,
+			span<const uint8_t> indices, const bool& index32, const AABB& bounds,
+			const BoundingSphere& boundingSphere, const ref<void>& owner,
+			const ref<Material>& material, const MeshParams& params)
+	{
+		return makeRef<Mesh>(vertices, indices, index32, bounds, boundingSphere,
+			owner, material, params);
+	}
+
 	void Mesh::setMaterial(const ref<Material>& material)
 	{
 		this->material = material;
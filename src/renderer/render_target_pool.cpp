@@ -0,0 +1,180 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include "defines.hpp"
+#include "flat_map.hpp"
+#include "renderer/render_target_pool.hpp"
+
+namespace core
+{
+	struct PooledTarget
+	{
+		Texture2D* texture;
+		uint64_t releasedFrame;
+	};
+
+	struct RenderTargetPoolData
+	{
+		RenderTargetPoolParams params;
+		FlatMap<std::vector<PooledTarget>> targets; // By getKey()
+		uint64_t frame = 0;
+		uint32_t freeCount = 0;
+		uint32_t createdCount = 0;
+	};
+	static RenderTargetPoolData* data;
+
+	// Outside data, targets can be returned after shutdown
+	static std::mutex poolMutex;
+
+	/*
+	 * Targets are interchangeable if everything that goes into their bgfx
+	 * format, size and flags is equal
+	 */
+	static StringID getKey(const Texture2DParams& params)
+	{
+		const uint64_t fields[] =
+		{
+			static_cast<uint64_t>(params.format),
+			(static_cast<uint64_t>(params.width) << 16) | params.height,
+			(params.hasMips ? 1u : 0u) | (params.nearest ? 2u : 0u) |
+			(params.stretch ? 4u : 0u) | (params.compare ? 8u : 0u),
+		};
+		return StringID(hashFNV1a(reinterpret_cast<const char*>(fields),
+			sizeof(fields)));
+	}
+
+	void RenderTargetPool::init(const RenderTargetPoolParams& params)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		ASSERT(!data, "Render target pool is already initialized");
+		data = new RenderTargetPoolData();
+		data->params = params;
+	}
+
+	void RenderTargetPool::shutdown()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for (auto& [key, targets] : data->targets)
+		{
+			for (const PooledTarget& target : targets)
+			{
+				delete target.texture;
+			}
+		}
+
+		delete data;
+		data = nullptr;
+	}
+
+	ref<Texture2D> RenderTargetPool::acquire(const Texture2DParams& params)
+	{
+		Texture2DParams targetParams = params;
+		targetParams.isRenderTarget = true;
+
+		Texture2D* texture = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			ASSERT(data, "Render target pool is not initialized");
+
+			if (std::vector<PooledTarget>* targets = data->targets.find(
+				getKey(targetParams)))
+			{
+				// Oldest first, they are the most likely to be done with
+				for (size_t i = 0; i < targets->size(); i++)
+				{
+					if ((*targets)[i].releasedFrame + data->params.reuseDelay <=
+						data->frame)
+					{
+						texture = (*targets)[i].texture;
+						targets->erase(targets->begin() + i);
+						data->freeCount--;
+						break;
+					}
+				}
+			}
+
+			if (!texture)
+			{
+				data->createdCount++;
+			}
+		}
+
+		if (!texture)
+		{
+			texture = new Texture2D(nullptr, targetParams);
+		}
+
+		return ref<Texture2D>(texture, [](Texture2D* texture)
+			{
+				release(texture);
+			});
+	}
+
+	void RenderTargetPool::release(Texture2D* texture)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (!data)
+		{
+			delete texture;
+			return;
+		}
+
+		data->targets[getKey(texture->getParams())].push_back(
+			{ texture, data->frame });
+		data->freeCount++;
+	}
+
+	void RenderTargetPool::update()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		data->frame++;
+
+		for (auto& [key, targets] : data->targets)
+		{
+			// Released in frame order, idle targets are at the front
+			size_t idle = 0;
+			while (idle < targets.size() && data->frame -
+				targets[idle].releasedFrame > data->params.maxIdleFrames)
+			{
+				delete targets[idle++].texture;
+			}
+
+			targets.erase(targets.begin(), targets.begin() + idle);
+			data->freeCount -= static_cast<uint32_t>(idle);
+		}
+	}
+
+	uint32_t RenderTargetPool::getFreeCount()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return data ? data->freeCount : 0;
+	}
+
+	uint32_t RenderTargetPool::getCreatedCount()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return data ? data->createdCount : 0;
+	}
+
+	bool RenderTargetPool::isInitialized()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return data != nullptr;
+	}
+}
@@ -16,34 +16,389 @@
 
 #include "crpch.hpp"
 
+#include <bitset>
+#include <cstring>
+#include <thread>
 #include <bgfx/bgfx.h>
 
 #include "math.hpp"
 #include "defines.hpp"
 #include "renderer/renderer.hpp"
 #include "renderer/framebuffer.hpp"
+#include "renderer/light_clusters.hpp"
+#include "renderer/shadow_maps.hpp"
+#include "renderer/texture_loader.hpp"
+#include "renderer/uniform_registry.hpp"
+#include "jobs/job_system.hpp"
 #include "debug/logger.hpp"
 
 namespace core
 {
+	/*
+	 * A mesh submission recorded while sorting is enabled for the current
+	 * pass, replayed in sort key order at endPass()
+	 */
+	struct DrawCommand
+	{
+		ref<Mesh> mesh;
+		glm::mat4 transform;
+	};
+
+	/*
+	 * Number of bgfx views, passes are indexed by their view id
+	 */
+	static constexpr uint32_t maxPasses = 256;
+
+	/*
+	 * Sort key and index of the draw command it belongs to, this is what
+	 * actually gets sorted so the draw commands themselves never move
+	 */
+	struct DrawSortItem
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	/*
+	 * Sorted draws sharing vertex array and material, instanced as one draw
+	 * when the shader allows it. Programs are resolved before encoding since
+	 * the shader manager is not thread safe
+	 */
+	struct DrawRun
+	{
+		uint32_t begin;
+		uint32_t end;
+		bgfx::ProgramHandle program;
+		bgfx::ProgramHandle instancedProgram;
+	};
+
+	/*
+	 * Sorted passes smaller than this are encoded on the calling thread,
+	 * bigger ones get an encoder per this many draws
+	 */
+	static constexpr uint32_t minDrawsPerEncoder = 1024;
+	static constexpr uint32_t cullBatchSize = 1024;
+
 	struct RendererData
 	{
 		ref<ShaderManager> shaderManager;
 
+		std::vector<ref<Light>> lights;
+		// One set of froxel textures per lit pass of a frame, the textures
+		// are only updated when the frame is submitted
+		std::vector<ref<LightClusters>> lightClusters;
+		uint32_t litPassCount = 0; // Lit passes begun this frame
+		ref<LightClusters> currLightClusters;
+
+		ShadowMapsParams shadowParams;
+		ref<ShadowMaps> shadowMaps; // Created by the first renderShadows
+		std::bitset<maxPasses> passViews; // Views beginPass has been used with this frame
+
 		std::vector<bgfx::FrameBufferHandle> framebuffers;
 
 		ref<Camera> currCamera;
 		uint16_t currPassID;
-
+		uint32_t currPassHeight;
+		uint64_t uploadedRevision; // Material revision whose uniforms bgfx holds
+		bool currPassSorted;
+		bool currPassCulled;
+		bool currPassLit;
+
+		PassStats passStats[maxPasses];
+
+		std::vector<DrawCommand> drawCommands;
+		std::vector<AABB> drawBounds;
+		std::vector<uint8_t> drawVisible;
+		std::vector<DrawSortItem> drawSortItems;
+		std::vector<DrawSortItem> drawSortScratch;
+		std::vector<DrawRun> drawRuns;
+		std::vector<uint32_t> encoderRuns; // First run of every encoder
+		std::vector<std::vector<glm::mat4>> encoderMatrices;
+		std::vector<glm::mat4> instanceMatrices;
+		std::mutex instanceMutex;
+		std::vector<uint32_t> visibleProxies;
 	};
 	static RendererData* data;
 
+	/*
+	 * Discard flags for a submit that is followed by a draw with the same
+	 * material, texture bindings and state are kept for the next draw
+	 */
+	static constexpr uint8_t discardKeepMaterial = BGFX_DISCARD_TRANSFORM |
+		BGFX_DISCARD_VERTEX_STREAMS | BGFX_DISCARD_INDEX_BUFFER |
+		BGFX_DISCARD_INSTANCE_DATA;
+
+	/*
+	 * Sort key layout, most significant bits first
+	 *
+	 * Opaque:      pass (8) | blend (1) | program (9) | material (14) | mesh (12) | depth (20)
+	 * Translucent: pass (8) | blend (1) | inverted depth (20) | program (9) | material (14) | mesh (12)
+	 *
+	 * Opaque meshes are grouped by state and drawn front to back within each
+	 * group, translucent meshes are drawn back to front. Grouping by mesh
+	 * last makes identical opaque draws adjacent so they can be instanced
+	 */
+	static uint64_t encodeSortKey(const uint16_t passID, const Material& material,
+		const uint16_t program, const uint16_t mesh, const float depth)
+	{
+		const uint64_t pass = static_cast<uint64_t>(passID & 0xff);
+		const uint64_t prog = static_cast<uint64_t>(program & 0x1ff);
+		const uint64_t mat = static_cast<uint64_t>(material.getID() & 0x3fff);
+		const uint64_t vao = static_cast<uint64_t>(mesh & 0xfff);
+		const uint64_t dep = static_cast<uint64_t>(
+			glm::clamp(depth, 0.0f, 1.0f) * static_cast<float>(0xfffff));
+
+		if (material.getParams().blendType == BlendType::Translucent)
+		{
+			return (pass << 56) | (1ull << 55) | ((0xfffff - dep) << 35) |
+				(prog << 26) | (mat << 12) | vao;
+		}
+
+		return (pass << 56) | (prog << 46) | (mat << 32) | (vao << 20) | dep;
+	}
+
+	/*
+	 * Binds a material for the next draw of an encoder. Uniform values are
+	 * kept by bgfx, in sorted passes they are skipped if the last values the
+	 * encoder uploaded belong to the same material revision. Other passes
+	 * let bgfx reorder draws, so they always upload
+	 */
+	void Renderer::bindMaterial(bgfx::Encoder* encoder, const Material& material,
+		uint64_t& uploadedRevision)
+	{
+		const bool upload = !data->currPassSorted ||
+			material.getRevision() != uploadedRevision;
+		material.updateUniforms(encoder, upload);
+		if (data->currPassLit && material.getParams().shadingType == ShadingType::Lit)
+		{
+			data->currLightClusters->bind(encoder, upload);
+			if (data->shadowMaps)
+			{
+				data->shadowMaps->bind(encoder, upload);
+			}
+		}
+		uploadedRevision = material.getRevision();
+	}
+
+	/*
+	 * Reports the screen size of a drawn mesh to the streamed textures of
+	 * its material, estimated from the projected size of its bounds
+	 */
+	void Renderer::requestTextureSizes(const Material& material,
+		const AABB& worldBounds)
+	{
+		if (material.textures.empty())
+		{
+			return;
+		}
+
+		const glm::vec3 center = worldBounds.getCenter();
+		const float radius = glm::length(worldBounds.max - worldBounds.min) * 0.5f;
+		// Left handed view space, visible objects are at positive z
+		const float distance = (data->currCamera->getViewMatrix() *
+			glm::vec4(center, 1.0f)).z;
+		const float screenSize = radius *
+			data->currCamera->getProjectionMatrix()[1][1] *
+			static_cast<float>(data->currPassHeight) / std::max(distance, radius);
+
+		for (const auto& [name, texture] : material.textures)
+		{
+			if (texture)
+			{
+				TextureLoader::requestSize(*texture, screenSize);
+			}
+		}
+	}
+
+	/*
+	 * Variant of the material's shader a mesh is drawn with, packed vertex
+	 * formats and instancing add their features to the material's. Returns
+	 * nullptr for instanced variants the renderer or shader lacks
+	 */
+	ref<Shader> Renderer::getMeshShader(const Mesh& mesh, const bool& instanced)
+	{
+		const Material& material = *mesh.getMaterial();
+		uint32_t features = material.getShaderFeatures();
+		if (mesh.getVertexFormat() != VertexFormat::Float)
+		{
+			features |= ShaderFeaturePacked;
+		}
+
+		if (instanced)
+		{
+			if (!(bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING))
+			{
+				return nullptr;
+			}
+			return data->shaderManager->getVariant(material.getShaderID(),
+				features | ShaderFeatureInstanced);
+		}
+
+		ref<Shader> shader = data->shaderManager->getVariant(
+			material.getShaderID(), features);
+		ASSERT(shader, "Mesh shader variant is missing");
+		return shader;
+	}
+
+	/*
+	 * Submits the same vertex array once with a model matrix per instance
+	 *
+	 * @return Number of instances that was submitted, can be less than count
+	 * if bgfx ran out of instance data buffer space this frame
+	 */
+	uint32_t Renderer::submitInstances(bgfx::Encoder* encoder,
+		const ref<VertexArray>& vao, const bgfx::ProgramHandle instancedProgram,
+		const glm::mat4* matrices, const uint32_t count, const uint8_t discard,
+		const uint32_t depth)
+	{
+		constexpr uint16_t stride = sizeof(glm::mat4);
+		bgfx::InstanceDataBuffer idb;
+		{
+			// Encoders share the frame's instance data, keep another thread
+			// from taking the space between checking and allocating it
+			std::lock_guard<std::mutex> lock(data->instanceMutex);
+			const uint32_t instanceCount = bgfx::getAvailInstanceDataBuffer(
+				count, stride);
+			if (instanceCount == 0)
+			{
+				return 0;
+			}
+			bgfx::allocInstanceDataBuffer(&idb, instanceCount, stride);
+		}
+		const uint32_t instanceCount = idb.num;
+		memcpy(idb.data, matrices, instanceCount * stride);
+
+		encoder->setInstanceDataBuffer(&idb);
+		encoder->setVertexBuffer(0, vao->vertexBuffer->handle);
+		encoder->setIndexBuffer(vao->indexBuffer->handle);
+		encoder->submit(data->currPassID, instancedProgram, depth,
+			(instanceCount < count) ? discardKeepMaterial : discard);
+
+		return instanceCount;
+	}
+
+	/*
+	 * Encodes a range of draw runs with an encoder of the calling thread.
+	 * The sorted position of every draw is submitted as its depth, so bgfx
+	 * merges the encoders back into sort order
+	 */
+	void Renderer::encodeRuns(const uint32_t firstRun, const uint32_t lastRun,
+		std::vector<glm::mat4>& matrices)
+	{
+		bgfx::Encoder* encoder = beginEncoder();
+
+		const std::vector<DrawSortItem>& items = data->drawSortItems;
+		const Material* prevMaterial = nullptr;
+		uint64_t uploadedRevision = 0;
+		for (uint32_t r = firstRun; r < lastRun; r++)
+		{
+			const DrawRun& run = data->drawRuns[r];
+			const DrawCommand& command = data->drawCommands[items[run.begin].index];
+			const Material* material = command.mesh->getMaterial().get();
+			const ref<VertexArray>& vao = command.mesh->getVertexArray();
+			const bool quantized = command.mesh->getVertexFormat() == VertexFormat::Quantized;
+			const glm::mat4& decodeMatrix = command.mesh->getDecodeMatrix();
+
+			if (material != prevMaterial)
+			{
+				bindMaterial(encoder, *material, uploadedRevision);
+				prevMaterial = material;
+			}
+
+			// Keep bindings and state alive if the next draw uses the same material
+			const bool keepMaterial = (r + 1 < lastRun) &&
+				(data->drawCommands[items[data->drawRuns[r + 1].begin].index].mesh->
+					getMaterial().get() == material);
+			const uint8_t discard = keepMaterial ?
+				discardKeepMaterial : BGFX_DISCARD_ALL;
+
+			// Instance the whole run in one draw if possible, whatever did
+			// not fit in the instance data buffer is drawn one by one
+			uint32_t i = run.begin;
+			if (bgfx::isValid(run.instancedProgram))
+			{
+				matrices.clear();
+				for (uint32_t j = run.begin; j < run.end; j++)
+				{
+					const glm::mat4& transform = data->drawCommands[items[j].index].transform;
+					matrices.push_back(quantized ? transform * decodeMatrix : transform);
+				}
+
+				i += submitInstances(encoder, vao, run.instancedProgram,
+					matrices.data(), run.end - run.begin, discard, run.begin);
+			}
+
+			for (; i < run.end; i++)
+			{
+				const glm::mat4& transform = data->drawCommands[items[i].index].transform;
+				const glm::mat4 matrix = quantized ? transform * decodeMatrix : transform;
+				encoder->setTransform(&matrix[0][0]);
+				encoder->setVertexBuffer(0, vao->vertexBuffer->handle);
+				encoder->setIndexBuffer(vao->indexBuffer->handle);
+				encoder->submit(data->currPassID, run.program, i,
+					(i + 1 < run.end) ? discardKeepMaterial : discard);
+			}
+		}
+
+		endEncoder(encoder);
+	}
+
+	/*
+	 * Least significant digit radix sort on the 64-bit sort keys, one byte
+	 * at a time. Bytes that are equal for every key are skipped
+	 */
+	static void radixSort(std::vector<DrawSortItem>& items,
+		std::vector<DrawSortItem>& scratch)
+	{
+		const size_t count = items.size();
+		scratch.resize(count);
+
+		DrawSortItem* src = items.data();
+		DrawSortItem* dst = scratch.data();
+
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			uint32_t histogram[256] = {};
+			for (size_t i = 0; i < count; i++)
+			{
+				histogram[(src[i].key >> shift) & 0xff]++;
+			}
+
+			// Every key has the same byte here, nothing to do
+			if (histogram[(src[0].key >> shift) & 0xff] == count)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram)
+			{
+				const uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+			}
+
+			std::swap(src, dst);
+		}
+
+		if (src != items.data())
+		{
+			items.swap(scratch);
+		}
+	}
+
 	void Renderer::init()
 	{
 		data = new RendererData();
 		data->shaderManager = makeRef<ShaderManager>();
 
-		// Shaders
+		// Shaders, variants of the uber shader are loaded as materials need
+		// them
 		data->shaderManager->loadAndAdd(
 			"../../shaders/compiled/uber-vert.bin", 
 			"../../shaders/compiled/uber-frag.bin");
@@ -56,18 +411,43 @@ namespace core
 				"../../shaders/compiled/debugdraw-vert.bin", 
 				"../../shaders/compiled/debugdraw-frag.bin");
 		#endif
+
+		data->lightClusters.push_back(LightClusters::create());
 	}
 
 	void Renderer::shutdown()
 	{
+		UniformRegistry::shutdown();
 		delete data;
 	}
 
+	void Renderer::beginFrame()
+	{
+		data->passViews.reset();
+		data->litPassCount = 0;
+	}
+
 	bool Renderer::beginPass(const ref<Camera>& camera, const PassParams& params)
 	{
 		ASSERT(camera, "Camera is null, camera is needed to render");
+		ASSERT(!data->shadowMaps || !data->shadowMaps->isShadowView(params.id),
+			"Pass uses a view reserved for shadow cascades");
+		data->passViews.set(params.id % maxPasses);
 		data->currCamera = camera;
 		data->currPassID = params.id;
+		data->currPassHeight = params.height;
+		data->uploadedRevision = 0;
+		data->currPassSorted = params.sortSubmissions;
+		data->currPassCulled = params.frustumCulling;
+		data->currPassLit = params.lighting;
+		data->passStats[params.id % maxPasses] = PassStats();
+		data->drawCommands.clear();
+		data->drawBounds.clear();
+
+		// Submissions are already sorted by us and carry their sorted
+		// position as depth, which keeps the order across encoders
+		bgfx::setViewMode(params.id, params.sortSubmissions ?
+			bgfx::ViewMode::DepthAscending : bgfx::ViewMode::Default);
 
 		// Set viewport
 		bgfx::setViewRect(params.id, 0, 0, params.width, params.height);
@@ -76,17 +456,159 @@ namespace core
 		bgfx::setViewClear(params.id, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xe3fcffff, 1.0f, 0);
 
 		// Set framebuffer
-		bgfx::setViewFrameBuffer(params.id, params.framebuffer->handle);
+		bgfx::setViewFrameBuffer(params.id, params.framebuffer ?
+			params.framebuffer->handle : bgfx::FrameBufferHandle(BGFX_INVALID_HANDLE));
 		
 		// Update camera uniform to shader
 		bgfx::setViewTransform(params.id, &camera->getViewMatrix()[0][0],
 			&camera->getProjectionMatrix()[0][0]);
 
+		// Lights of the pass, binned before any draw binds them
+		if (params.lighting)
+		{
+			if (data->litPassCount == data->lightClusters.size())
+			{
+				data->lightClusters.push_back(LightClusters::create());
+			}
+			data->currLightClusters = data->lightClusters[data->litPassCount++];
+			data->currLightClusters->build(data->lights, *camera);
+		}
+
 		return true;
 	}
 	void Renderer::endPass()
 	{
-	
+		if (!data->currPassSorted || data->drawCommands.empty())
+		{
+			return;
+		}
+
+		// Cull every recorded draw at once, batches write their own range
+		// of the visibility flags
+		const uint32_t commandCount = static_cast<uint32_t>(data->drawCommands.size());
+		data->drawVisible.assign(commandCount, 1);
+		if (data->currPassCulled)
+		{
+			const Frustum& frustum = data->currCamera->getFrustum();
+			std::atomic<uint32_t> visibleCount = 0;
+			JobSystem::parallelFor(commandCount, cullBatchSize,
+				[&](uint32_t begin, uint32_t end)
+				{
+					visibleCount += math::cullAABBs(frustum,
+						data->drawBounds.data() + begin, end - begin,
+						data->drawVisible.data() + begin);
+				});
+			data->passStats[data->currPassID % maxPasses].culled +=
+				commandCount - visibleCount;
+		}
+
+		// Build sort keys for the visible draws
+		const glm::mat4& view = data->currCamera->getViewMatrix();
+		const float clipFar = data->currCamera->getParams().clipFar;
+
+		data->drawSortItems.clear();
+		for (uint32_t i = 0; i < commandCount; i++)
+		{
+			if (!data->drawVisible[i])
+			{
+				continue;
+			}
+
+			const DrawCommand& command = data->drawCommands[i];
+			const Material& material = *command.mesh->getMaterial();
+			requestTextureSizes(material, data->drawBounds[i]);
+
+			const float depth = (view * glm::vec4(
+				data->drawBounds[i].getCenter(), 1.0f)).z / clipFar;
+
+			data->drawSortItems.push_back({ encodeSortKey(data->currPassID,
+				material, getMeshShader(*command.mesh)->handle.idx,
+				command.mesh->getVertexArray()->vertexBuffer->handle.idx,
+				depth), i });
+		}
+
+		if (data->drawSortItems.empty())
+		{
+			data->drawCommands.clear();
+			data->drawBounds.clear();
+			return;
+		}
+
+		radixSort(data->drawSortItems, data->drawSortScratch);
+
+		// Find the runs of draws sharing both vertex array and material,
+		// translucent draws are left alone to keep their ordering
+		const std::vector<DrawSortItem>& items = data->drawSortItems;
+		const uint32_t itemCount = static_cast<uint32_t>(items.size());
+		data->drawRuns.clear();
+		for (uint32_t i = 0; i < itemCount; )
+		{
+			const ref<Mesh>& mesh = data->drawCommands[items[i].index].mesh;
+			const Material* material = mesh->getMaterial().get();
+			const ref<VertexArray>& vao = mesh->getVertexArray();
+
+			uint32_t runEnd = i + 1;
+			if (material->params.blendType == BlendType::Opaque)
+			{
+				while (runEnd < itemCount)
+				{
+					const ref<Mesh>& next = data->drawCommands[items[runEnd].index].mesh;
+					if (next->getVertexArray() != vao ||
+						next->getMaterial().get() != material)
+					{
+						break;
+					}
+					runEnd++;
+				}
+			}
+
+			const ref<Shader> instancedShader = (runEnd - i > 1) ?
+				getMeshShader(*mesh, true) : nullptr;
+			data->drawRuns.push_back({ i, runEnd, getMeshShader(*mesh)->handle,
+				instancedShader ? instancedShader->handle :
+				bgfx::ProgramHandle(BGFX_INVALID_HANDLE) });
+			i = runEnd;
+		}
+
+		// Split the runs into ranges of about the same number of draws, one
+		// encoder each. Other threads can only use the encoders bgfx has
+		// left besides the main thread's
+		const uint32_t maxEncoders = std::max<uint32_t>(
+			bgfx::getCaps()->limits.maxEncoders, 2) - 1;
+		const uint32_t encoderCount = std::clamp(itemCount / minDrawsPerEncoder,
+			1u, std::min(JobSystem::getThreadCount(), maxEncoders));
+
+		const uint32_t runCount = static_cast<uint32_t>(data->drawRuns.size());
+		data->encoderRuns.assign(1, 0);
+		for (uint32_t r = 0; r < runCount; r++)
+		{
+			const uint32_t encoder = static_cast<uint32_t>(data->encoderRuns.size());
+			if (encoder < encoderCount &&
+				data->drawRuns[r].begin >= itemCount * encoder / encoderCount)
+			{
+				data->encoderRuns.push_back(r);
+			}
+		}
+		data->encoderRuns.push_back(runCount);
+
+		const uint32_t rangeCount = static_cast<uint32_t>(data->encoderRuns.size()) - 1;
+		if (data->encoderMatrices.size() < rangeCount)
+		{
+			data->encoderMatrices.resize(rangeCount);
+		}
+
+		JobSystem::parallelFor(rangeCount, 1, [](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t range = begin; range < end; range++)
+				{
+					encodeRuns(data->encoderRuns[range],
+						data->encoderRuns[range + 1],
+						data->encoderMatrices[range]);
+				}
+			});
+
+		data->drawCommands.clear();
+		data->drawBounds.clear();
 	}
 
 	void Renderer::render(const uint32_t& width, const uint32_t& height)
@@ -113,7 +635,7 @@ namespace core
 	}
 
 	void Renderer::submitVertexArray(const ref<VertexArray>& vao,
-		const std::string& shaderName)
+		const StringID& shaderName)
 	{
 		ASSERT(vao, "Vertex Array Buffer is invalid");
 		ref<Shader> shaderRef = data->shaderManager->get(shaderName);
@@ -142,21 +664,161 @@ namespace core
 	void Renderer::submitMesh(const ref<Mesh>& mesh, const Transform& transform)
 	{
 		ASSERT(mesh, "Mesh is invalid");
-		
-		// Handle Transform
-		bgfx::setTransform(&(math::composeMatrix(transform) *
-			math::composeMatrix(mesh->getTransform()))[0][0]);
 
+		const glm::mat4 matrix = math::composeMatrix(transform) *
+			math::composeMatrix(mesh->getTransform());
+		const AABB worldBounds = math::transformAABB(mesh->getBounds(), matrix);
+
+		if (data->currPassCulled && !data->currPassSorted &&
+			!math::isVisible(data->currCamera->getFrustum(), worldBounds))
+		{
+			data->passStats[data->currPassID % maxPasses].submitted++;
+			data->passStats[data->currPassID % maxPasses].culled++;
+			return;
+		}
+
+		submitMeshMatrix(mesh, matrix, worldBounds);
+	}
+
+	void Renderer::submitMeshMatrix(const ref<Mesh>& mesh,
+		const glm::mat4& matrix, const AABB& worldBounds)
+	{
 		// Only submit mesh if material is valid 
 		// @todo Add standard material if not material is submitted
-		if (mesh->getMaterial())
+		if (!mesh->getMaterial())
 		{
-			// Material
-			mesh->getMaterial()->updateUniforms();
+			return;
+		}
+
+		data->passStats[data->currPassID % maxPasses].submitted++;
 
-			// Submit
-			submitVertexArray(mesh->getVertexArray(), mesh->getMaterial()->getShader());
+		// Record for culling and sorting at endPass instead of submitting
+		// right away
+		if (data->currPassSorted)
+		{
+			data->drawCommands.push_back({ mesh, matrix });
+			data->drawBounds.push_back(worldBounds);
+			return;
+		}
+
+		const ref<Shader> shader = getMeshShader(*mesh);
+		ASSERT(shader, "Shader is invalid");
+		bgfx::Encoder* encoder = beginEncoder();
+
+		// Handle Transform, quantized positions are decoded by the model matrix
+		if (mesh->getVertexFormat() == VertexFormat::Quantized)
+		{
+			const glm::mat4 decodedMatrix = matrix * mesh->getDecodeMatrix();
+			encoder->setTransform(&decodedMatrix[0][0]);
 		}
+		else
+		{
+			encoder->setTransform(&matrix[0][0]);
+		}
+
+		// Material
+		requestTextureSizes(*mesh->getMaterial(), worldBounds);
+		bindMaterial(encoder, *mesh->getMaterial(), data->uploadedRevision);
+
+		// Submit
+		const ref<VertexArray>& vao = mesh->getVertexArray();
+		encoder->setVertexBuffer(0, vao->vertexBuffer->handle);
+		encoder->setIndexBuffer(vao->indexBuffer->handle);
+		encoder->submit(data->currPassID, shader->handle);
+		endEncoder(encoder);
+	}
+
+	void Renderer::submitMeshInstanced(const ref<Mesh>& mesh,
+		span<const Transform> transforms)
+	{
+		ASSERT(mesh, "Mesh is invalid");
+
+		// @todo Add standard material if not material is submitted
+		if (!mesh->getMaterial() || transforms.empty())
+		{
+			return;
+		}
+
+		// Sorted passes group identical draws into instances by themselves
+		const ref<Shader> instancedShader = data->currPassSorted ?
+			nullptr : getMeshShader(*mesh, true);
+		if (!instancedShader)
+		{
+			for (const Transform& transform : transforms)
+			{
+				submitMesh(mesh, transform);
+			}
+			return;
+		}
+
+		const uint32_t count = static_cast<uint32_t>(transforms.size());
+		const glm::mat4 meshMatrix = math::composeMatrix(mesh->getTransform());
+		data->instanceMatrices.resize(count);
+		data->drawBounds.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			data->instanceMatrices[i] = math::composeMatrix(transforms[i]) *
+				meshMatrix;
+			data->drawBounds[i] = math::transformAABB(mesh->getBounds(),
+				data->instanceMatrices[i]);
+		}
+
+		// Drop instances outside the frustum
+		uint32_t visibleCount = count;
+		if (data->currPassCulled)
+		{
+			data->drawVisible.resize(count);
+			math::cullAABBs(data->currCamera->getFrustum(),
+				data->drawBounds.data(), count, data->drawVisible.data());
+
+			visibleCount = 0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (data->drawVisible[i])
+				{
+					data->instanceMatrices[visibleCount] = data->instanceMatrices[i];
+					data->drawBounds[visibleCount++] = data->drawBounds[i];
+				}
+			}
+		}
+		for (uint32_t i = 0; i < visibleCount; i++)
+		{
+			requestTextureSizes(*mesh->getMaterial(), data->drawBounds[i]);
+		}
+		data->drawBounds.clear();
+
+		if (mesh->getVertexFormat() == VertexFormat::Quantized)
+		{
+			for (uint32_t i = 0; i < visibleCount; i++)
+			{
+				data->instanceMatrices[i] *= mesh->getDecodeMatrix();
+			}
+		}
+
+		PassStats& stats = data->passStats[data->currPassID % maxPasses];
+		stats.submitted += count;
+		stats.culled += count - visibleCount;
+
+		// Instance data buffer space is limited per frame, submit in chunks
+		uint32_t submitted = 0;
+		bgfx::Encoder* encoder = beginEncoder();
+		while (submitted < visibleCount)
+		{
+			bindMaterial(encoder, *mesh->getMaterial(), data->uploadedRevision);
+
+			const uint32_t instanced = submitInstances(encoder,
+				mesh->getVertexArray(), instancedShader->handle,
+				data->instanceMatrices.data() + submitted,
+				visibleCount - submitted, BGFX_DISCARD_ALL);
+			if (instanced == 0)
+			{
+				Logger::logWarn("Out of instance data buffer space, %u instances were dropped",
+					visibleCount - submitted);
+				break;
+			}
+			submitted += instanced;
+		}
+		endEncoder(encoder);
 	}
 
 	void Renderer::submitBatch(const ref<Batch>& batch, const Transform& transform)
@@ -168,10 +830,128 @@ namespace core
 			batch->flush();
 		}
 
-		for (uint32_t i = 0; i < batch->getBatchedMeshes().size(); i++)
+		const std::vector<ref<Mesh>>& meshes = batch->getBatchedMeshes();
+		const uint32_t count = static_cast<uint32_t>(meshes.size());
+		const glm::mat4 batchMatrix = math::composeMatrix(transform);
+
+		// Bounds of every batched mesh, culled together below
+		std::vector<glm::mat4> matrices(count);
+		std::vector<AABB> bounds(count);
+		std::vector<uint8_t> visible(count, 1);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			matrices[i] = batchMatrix * math::composeMatrix(meshes[i]->getTransform());
+			bounds[i] = math::transformAABB(meshes[i]->getBounds(), matrices[i]);
+		}
+
+		if (data->currPassCulled && !data->currPassSorted)
 		{
-			submitMesh(batch->getBatchedMeshes()[i], transform);
+			const uint32_t visibleCount = math::cullAABBs(
+				data->currCamera->getFrustum(), bounds.data(), count,
+				visible.data());
+
+			PassStats& stats = data->passStats[data->currPassID % maxPasses];
+			stats.submitted += count - visibleCount;
+			stats.culled += count - visibleCount;
 		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (visible[i])
+			{
+				submitMeshMatrix(meshes[i], matrices[i], bounds[i]);
+			}
+		}
+	}
+
+	void Renderer::submitScene(const ref<SceneBVH>& scene)
+	{
+		ASSERT(scene, "Scene is invalid");
+
+		if (!data->currPassCulled)
+		{
+			for (const SceneBVH::Proxy& proxy : scene->proxies)
+			{
+				if (proxy.node != -1)
+				{
+					submitMeshMatrix(proxy.mesh, proxy.matrix,
+						scene->nodes[proxy.node].bounds);
+				}
+			}
+			return;
+		}
+
+		data->visibleProxies.clear();
+		scene->queryFrustum(data->currCamera->getFrustum(), data->visibleProxies);
+
+		const uint32_t culledCount = scene->getProxyCount() -
+			static_cast<uint32_t>(data->visibleProxies.size());
+		PassStats& stats = data->passStats[data->currPassID % maxPasses];
+		stats.submitted += culledCount;
+		stats.culled += culledCount;
+
+		for (const uint32_t proxyID : data->visibleProxies)
+		{
+			const SceneBVH::Proxy& proxy = scene->proxies[proxyID];
+			submitMeshMatrix(proxy.mesh, proxy.matrix,
+				scene->nodes[proxy.node].bounds);
+		}
+	}
+
+	const PassStats& Renderer::getPassStats(const uint16_t passID)
+	{
+		return data->passStats[passID % maxPasses];
+	}
+
+	void Renderer::addLight(const ref<Light>& light)
+	{
+		ASSERT(light, "Light is null");
+		data->lights.push_back(light);
+	}
+
+	void Renderer::removeLight(const ref<Light>& light)
+	{
+		const auto it = std::find(data->lights.begin(), data->lights.end(), light);
+		if (it != data->lights.end())
+		{
+			data->lights.erase(it);
+		}
+	}
+
+	const ref<LightClusters>& Renderer::getLightClusters()
+	{
+		return data->currLightClusters;
+	}
+
+	void Renderer::renderShadows(const ref<Camera>& camera,
+		const ref<SceneBVH>& scene, const glm::vec3& lightDirection)
+	{
+		ASSERT(camera, "Camera is null, camera is needed to render");
+		ASSERT(scene, "Scene is invalid");
+
+		if (!data->shadowMaps)
+		{
+			data->shadowMaps = ShadowMaps::create(data->shadowParams);
+		}
+
+		const ShadowMapsParams& params = data->shadowMaps->getParams();
+		for (uint32_t i = 0; i < params.cascadeCount; i++)
+		{
+			ASSERT(!data->passViews.test((params.firstViewID + i) % maxPasses),
+				"Shadow cascade view is already used by a pass");
+		}
+		data->shadowMaps->update(*camera, lightDirection, *scene);
+	}
+
+	void Renderer::setShadowParams(const ShadowMapsParams& params)
+	{
+		data->shadowParams = params;
+		data->shadowMaps = nullptr;
+	}
+
+	const ref<ShadowMaps>& Renderer::getShadowMaps()
+	{
+		return data->shadowMaps;
 	}
 
 	ref<ShaderManager> Renderer::getShaderManager()
@@ -179,5 +959,22 @@ namespace core
 		return data->shaderManager;
 	}
 
+	bgfx::Encoder* Renderer::beginEncoder()
+	{
+		// All encoders can be taken for a moment by other threads
+		bgfx::Encoder* encoder = bgfx::begin();
+		while (!encoder)
+		{
+			std::this_thread::yield();
+			encoder = bgfx::begin();
+		}
+		return encoder;
+	}
+
+	void Renderer::endEncoder(bgfx::Encoder* encoder)
+	{
+		bgfx::end(encoder);
+	}
+
 
 }
\ No newline at end of file
@@ -0,0 +1,665 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crpch.hpp"
+
+#include <algorithm>
+
+#include "math.hpp"
+#include "defines.hpp"
+#include "renderer/scene_bvh.hpp"
+
+namespace core
+{
+	static AABB combine(const AABB& a, const AABB& b)
+	{
+		return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+	}
+
+	static float surfaceArea(const AABB& box)
+	{
+		const glm::vec3 size = box.max - box.min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	SceneBVH::SceneBVH()
+		: root(-1), freeList(-1), proxyCount(0)
+	{
+	}
+
+	uint32_t SceneBVH::add(const ref<Mesh>& mesh, const Transform& transform)
+	{
+		ASSERT(mesh, "Mesh is invalid");
+
+		uint32_t proxyID;
+		if (!freeProxies.empty())
+		{
+			proxyID = freeProxies.back();
+			freeProxies.pop_back();
+		}
+		else
+		{
+			proxyID = static_cast<uint32_t>(proxies.size());
+			proxies.emplace_back();
+		}
+
+		Proxy& proxy = proxies[proxyID];
+		proxy.mesh = mesh;
+		proxy.transform = transform;
+		proxy.matrix = math::composeMatrix(transform) *
+			math::composeMatrix(mesh->getTransform());
+
+		const int32_t leaf = allocateNode();
+		nodes[leaf].bounds = math::transformAABB(mesh->getBounds(), proxy.matrix);
+		nodes[leaf].proxyID = proxyID;
+		proxy.node = leaf;
+
+		insertLeaf(leaf);
+		proxyCount++;
+
+		return proxyID;
+	}
+
+	void SceneBVH::remove(const uint32_t& proxyID)
+	{
+		ASSERT(proxyID < proxies.size() && proxies[proxyID].node != -1,
+			"Invalid proxy id");
+
+		Proxy& proxy = proxies[proxyID];
+		removeLeaf(proxy.node);
+		freeNode(proxy.node);
+
+		proxy = Proxy();
+		freeProxies.push_back(proxyID);
+		proxyCount--;
+	}
+
+	void SceneBVH::setTransform(const uint32_t& proxyID, const Transform& transform)
+	{
+		ASSERT(proxyID < proxies.size() && proxies[proxyID].node != -1,
+			"Invalid proxy id");
+
+		Proxy& proxy = proxies[proxyID];
+		if (proxy.transform == transform)
+		{
+			return;
+		}
+
+		proxy.transform = transform;
+		proxy.matrix = math::composeMatrix(transform) *
+			math::composeMatrix(proxy.mesh->getTransform());
+
+		nodes[proxy.node].bounds = math::transformAABB(proxy.mesh->getBounds(),
+			proxy.matrix);
+		refitAncestors(nodes[proxy.node].parent);
+	}
+
+	void SceneBVH::rebuild()
+	{
+		// Keep the leaves, throw away every internal node
+		std::vector<int32_t> leaves;
+		std::vector<uint8_t> isLeaf(nodes.size(), 0);
+		leaves.reserve(proxyCount);
+		for (const Proxy& proxy : proxies)
+		{
+			if (proxy.node != -1)
+			{
+				leaves.push_back(proxy.node);
+				isLeaf[proxy.node] = 1;
+			}
+		}
+
+		freeList = -1;
+		for (int32_t i = static_cast<int32_t>(nodes.size()) - 1; i >= 0; i--)
+		{
+			if (isLeaf[i])
+			{
+				nodes[i].parent = -1;
+			}
+			else
+			{
+				freeNode(i);
+			}
+		}
+
+		root = leaves.empty() ? -1 :
+			buildRange(leaves, 0, static_cast<uint32_t>(leaves.size()));
+		if (root != -1)
+		{
+			nodes[root].parent = -1;
+		}
+	}
+
+	void SceneBVH::queryFrustum(const Frustum& frustum,
+		std::vector<uint32_t>& outProxies) const
+	{
+		if (root == -1)
+		{
+			return;
+		}
+
+		// Node and the planes it still needs to be tested against, children
+		// of a node fully inside a plane never test that plane again
+		struct StackEntry
+		{
+			int32_t node;
+			uint8_t planeMask;
+		};
+
+		std::vector<StackEntry> stack;
+		stack.push_back({ root, 0x3f });
+
+		while (!stack.empty())
+		{
+			const StackEntry entry = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[entry.node];
+
+			const glm::vec3 center = node.bounds.getCenter();
+			const glm::vec3 extents = node.bounds.getExtents();
+
+			uint8_t planeMask = entry.planeMask;
+			bool outside = false;
+			for (uint32_t i = 0; i < 6; i++)
+			{
+				if (!(planeMask & (1 << i)))
+				{
+					continue;
+				}
+
+				const glm::vec4& plane = frustum.planes[i];
+				const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+
+				if (distance + radius < 0.0f)
+				{
+					outside = true;
+					break;
+				}
+				if (distance - radius >= 0.0f)
+				{
+					planeMask &= ~(1 << i);
+				}
+			}
+
+			if (outside)
+			{
+				continue;
+			}
+
+			if (planeMask == 0 || node.isLeaf())
+			{
+				collectLeaves(entry.node, outProxies);
+				continue;
+			}
+
+			stack.push_back({ node.left, planeMask });
+			stack.push_back({ node.right, planeMask });
+		}
+	}
+
+	void SceneBVH::queryOverlap(const AABB& box,
+		std::vector<uint32_t>& outProxies) const
+	{
+		if (root == -1)
+		{
+			return;
+		}
+
+		std::vector<int32_t> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!math::overlaps(node.bounds, box))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				outProxies.push_back(node.proxyID);
+				continue;
+			}
+
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+
+	bool SceneBVH::raycast(const Ray& ray, RaycastHit& outHit,
+		const float& maxDistance) const
+	{
+		if (root == -1)
+		{
+			return false;
+		}
+
+		float closest = maxDistance;
+		bool hit = false;
+
+		std::vector<int32_t> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			float distance;
+			if (!math::intersectRayAABB(ray, node.bounds, closest, distance))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				closest = distance;
+				outHit.proxyID = node.proxyID;
+				outHit.distance = distance;
+				hit = true;
+				continue;
+			}
+
+			// Visit the nearest child first so the closest hit shrinks early
+			float leftDistance = CORE_BIG_NUMBER, rightDistance = CORE_BIG_NUMBER;
+			const bool hitLeft = math::intersectRayAABB(ray,
+				nodes[node.left].bounds, closest, leftDistance);
+			const bool hitRight = math::intersectRayAABB(ray,
+				nodes[node.right].bounds, closest, rightDistance);
+
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = leftDistance <= rightDistance;
+				stack.push_back(leftFirst ? node.right : node.left);
+				stack.push_back(leftFirst ? node.left : node.right);
+			}
+			else if (hitLeft)
+			{
+				stack.push_back(node.left);
+			}
+			else if (hitRight)
+			{
+				stack.push_back(node.right);
+			}
+		}
+
+		return hit;
+	}
+
+	ref<SceneBVH> SceneBVH::create()
+	{
+		return makeRef<SceneBVH>();
+	}
+
+	int32_t SceneBVH::allocateNode()
+	{
+		if (freeList == -1)
+		{
+			nodes.emplace_back();
+			return static_cast<int32_t>(nodes.size()) - 1;
+		}
+
+		const int32_t node = freeList;
+		freeList = nodes[node].right;
+		nodes[node] = Node();
+		return node;
+	}
+
+	void SceneBVH::freeNode(const int32_t& node)
+	{
+		nodes[node].parent = -1;
+		nodes[node].left = -1;
+		nodes[node].right = freeList;
+		freeList = node;
+	}
+
+	void SceneBVH::insertLeaf(const int32_t& leaf)
+	{
+		if (root == -1)
+		{
+			root = leaf;
+			nodes[root].parent = -1;
+			return;
+		}
+
+		// Walk down choosing the child where the surface area heuristic cost
+		// of placing the leaf is lowest
+		const AABB leafBounds = nodes[leaf].bounds;
+		int32_t index = root;
+		while (!nodes[index].isLeaf())
+		{
+			const Node& node = nodes[index];
+
+			const float area = surfaceArea(node.bounds);
+			const float combinedArea = surfaceArea(combine(node.bounds, leafBounds));
+
+			// Cost of creating a new parent for this node and the leaf
+			const float cost = 2.0f * combinedArea;
+
+			// Minimum cost of pushing the leaf further down the tree
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](const int32_t child)
+			{
+				const float newArea = surfaceArea(combine(nodes[child].bounds, leafBounds));
+				return nodes[child].isLeaf() ? newArea + inheritanceCost :
+					(newArea - surfaceArea(nodes[child].bounds)) + inheritanceCost;
+			};
+			const float leftCost = childCost(node.left);
+			const float rightCost = childCost(node.right);
+
+			if (cost < leftCost && cost < rightCost)
+			{
+				break;
+			}
+
+			index = (leftCost < rightCost) ? node.left : node.right;
+		}
+
+		// Create a new parent for the sibling and the leaf
+		const int32_t sibling = index;
+		const int32_t oldParent = nodes[sibling].parent;
+		const int32_t newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].bounds = combine(leafBounds, nodes[sibling].bounds);
+		nodes[newParent].left = sibling;
+		nodes[newParent].right = leaf;
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == -1)
+		{
+			root = newParent;
+		}
+		else if (nodes[oldParent].left == sibling)
+		{
+			nodes[oldParent].left = newParent;
+		}
+		else
+		{
+			nodes[oldParent].right = newParent;
+		}
+
+		refitAncestors(oldParent);
+	}
+
+	void SceneBVH::removeLeaf(const int32_t& leaf)
+	{
+		if (leaf == root)
+		{
+			root = -1;
+			return;
+		}
+
+		const int32_t parent = nodes[leaf].parent;
+		const int32_t grandParent = nodes[parent].parent;
+		const int32_t sibling = (nodes[parent].left == leaf) ?
+			nodes[parent].right : nodes[parent].left;
+
+		// Replace the parent with the sibling
+		if (grandParent == -1)
+		{
+			root = sibling;
+			nodes[sibling].parent = -1;
+		}
+		else
+		{
+			if (nodes[grandParent].left == parent)
+			{
+				nodes[grandParent].left = sibling;
+			}
+			else
+			{
+				nodes[grandParent].right = sibling;
+			}
+			nodes[sibling].parent = grandParent;
+		}
+
+		freeNode(parent);
+		refitAncestors(grandParent);
+	}
+
+	void SceneBVH::refitAncestors(int32_t node)
+	{
+		while (node != -1)
+		{
+			const int32_t balanced = balance(node);
+
+			Node& current = nodes[balanced];
+			const AABB bounds = combine(nodes[current.left].bounds,
+				nodes[current.right].bounds);
+			const int32_t height = 1 + std::max(nodes[current.left].height,
+				nodes[current.right].height);
+
+			// Nothing above can change once a node keeps its place, bounds
+			// and height
+			if (balanced == node && height == current.height &&
+				bounds.min == current.bounds.min && bounds.max == current.bounds.max)
+			{
+				break;
+			}
+
+			current.bounds = bounds;
+			current.height = height;
+			node = current.parent;
+		}
+	}
+
+	/*
+	 * Rotates the taller child of a node up if the heights of its children
+	 * differ by more than one, so sorted or clustered inserts can not grow
+	 * the tree into a list. Returns the node now at the top
+	 */
+	int32_t SceneBVH::balance(const int32_t& node)
+	{
+		Node& a = nodes[node];
+		if (a.isLeaf() || a.height < 2)
+		{
+			return node;
+		}
+
+		const int32_t left = a.left;
+		const int32_t right = a.right;
+		const int32_t difference = nodes[right].height - nodes[left].height;
+		if (difference >= -1 && difference <= 1)
+		{
+			return node;
+		}
+
+		// The taller child takes the place of the node, which adopts the
+		// shorter grandchild
+		const int32_t up = (difference > 1) ? right : left;
+		const int32_t kept = (difference > 1) ? left : right;
+		Node& b = nodes[up];
+
+		const int32_t tall = (nodes[b.left].height > nodes[b.right].height) ?
+			b.left : b.right;
+		const int32_t shortChild = (tall == b.left) ? b.right : b.left;
+
+		b.parent = a.parent;
+		if (b.parent == -1)
+		{
+			root = up;
+		}
+		else if (nodes[b.parent].left == node)
+		{
+			nodes[b.parent].left = up;
+		}
+		else
+		{
+			nodes[b.parent].right = up;
+		}
+
+		b.left = node;
+		b.right = tall;
+		a.parent = up;
+		a.left = kept;
+		a.right = shortChild;
+		nodes[shortChild].parent = node;
+
+		a.bounds = combine(nodes[kept].bounds, nodes[shortChild].bounds);
+		a.height = 1 + std::max(nodes[kept].height, nodes[shortChild].height);
+		b.bounds = combine(a.bounds, nodes[tall].bounds);
+		b.height = 1 + std::max(a.height, nodes[tall].height);
+
+		return up;
+	}
+
+	int32_t SceneBVH::buildRange(std::vector<int32_t>& leaves,
+		const uint32_t& begin, const uint32_t& end)
+	{
+		const uint32_t count = end - begin;
+		if (count == 1)
+		{
+			return leaves[begin];
+		}
+
+		// Bounds of the leaf centers, the split axis is the longest one
+		AABB centerBounds(nodes[leaves[begin]].bounds.getCenter(),
+			nodes[leaves[begin]].bounds.getCenter());
+		for (uint32_t i = begin + 1; i < end; i++)
+		{
+			const glm::vec3 center = nodes[leaves[i]].bounds.getCenter();
+			centerBounds.min = glm::min(centerBounds.min, center);
+			centerBounds.max = glm::max(centerBounds.max, center);
+		}
+
+		const glm::vec3 size = centerBounds.max - centerBounds.min;
+		const uint32_t axis = (size.x > size.y && size.x > size.z) ? 0 :
+			(size.y > size.z) ? 1 : 2;
+
+		uint32_t mid = begin + count / 2;
+		if (size[axis] > CORE_VERY_SMALL_NUMBER)
+		{
+			// Bin the leaves along the axis and find the cheapest split
+			constexpr uint32_t binCount = 16;
+			const float binScale = static_cast<float>(binCount) / size[axis];
+			auto binOf = [&](const int32_t leaf)
+			{
+				const float offset = nodes[leaf].bounds.getCenter()[axis] -
+					centerBounds.min[axis];
+				return glm::min(static_cast<uint32_t>(offset * binScale), binCount - 1);
+			};
+
+			uint32_t binCounts[binCount] = {};
+			AABB binBounds[binCount];
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const uint32_t bin = binOf(leaves[i]);
+				binBounds[bin] = binCounts[bin] == 0 ? nodes[leaves[i]].bounds :
+					combine(binBounds[bin], nodes[leaves[i]].bounds);
+				binCounts[bin]++;
+			}
+
+			// Sweep from the right to get the cost of every right side
+			float rightCosts[binCount] = {};
+			AABB rightBounds;
+			uint32_t rightCount = 0;
+			for (uint32_t i = binCount - 1; i > 0; i--)
+			{
+				if (binCounts[i] > 0)
+				{
+					rightBounds = rightCount == 0 ? binBounds[i] :
+						combine(rightBounds, binBounds[i]);
+					rightCount += binCounts[i];
+				}
+				rightCosts[i] = rightCount * (rightCount > 0 ? surfaceArea(rightBounds) : 0.0f);
+			}
+
+			// Sweep from the left and pick the cheapest split
+			float bestCost = CORE_BIG_NUMBER;
+			uint32_t bestSplit = 0;
+			AABB leftBounds;
+			uint32_t leftCount = 0;
+			for (uint32_t i = 0; i < binCount - 1; i++)
+			{
+				if (binCounts[i] > 0)
+				{
+					leftBounds = leftCount == 0 ? binBounds[i] :
+						combine(leftBounds, binBounds[i]);
+					leftCount += binCounts[i];
+				}
+
+				const float cost = leftCount * (leftCount > 0 ? surfaceArea(leftBounds) : 0.0f) +
+					rightCosts[i + 1];
+				if (leftCount > 0 && leftCount < count && cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = i;
+				}
+			}
+
+			const auto split = std::partition(leaves.begin() + begin,
+				leaves.begin() + end, [&](const int32_t leaf)
+				{
+					return binOf(leaf) <= bestSplit;
+				});
+			mid = static_cast<uint32_t>(split - leaves.begin());
+		}
+
+		// All leaves ended up on one side, split in the middle instead
+		if (mid == begin || mid == end)
+		{
+			mid = begin + count / 2;
+			std::nth_element(leaves.begin() + begin, leaves.begin() + mid,
+				leaves.begin() + end, [&](const int32_t a, const int32_t b)
+				{
+					return nodes[a].bounds.getCenter()[axis] <
+						nodes[b].bounds.getCenter()[axis];
+				});
+		}
+
+		const int32_t left = buildRange(leaves, begin, mid);
+		const int32_t right = buildRange(leaves, mid, end);
+
+		const int32_t node = allocateNode();
+		nodes[node].left = left;
+		nodes[node].right = right;
+		nodes[node].bounds = combine(nodes[left].bounds, nodes[right].bounds);
+		nodes[node].height = 1 + std::max(nodes[left].height, nodes[right].height);
+		nodes[left].parent = node;
+		nodes[right].parent = node;
+
+		return node;
+	}
+
+	void SceneBVH::collectLeaves(const int32_t& node,
+		std::vector<uint32_t>& outProxies) const
+	{
+		std::vector<int32_t> stack;
+		stack.push_back(node);
+
+		while (!stack.empty())
+		{
+			const Node& current = nodes[stack.back()];
+			stack.pop_back();
+
+			if (current.isLeaf())
+			{
+				outProxies.push_back(current.proxyID);
+				continue;
+			}
+
+			stack.push_back(current.right);
+			stack.push_back(current.left);
+		}
+	}
+}
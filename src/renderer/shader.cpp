@@ -16,6 +16,8 @@
 
 #include "crpch.hpp"
 
+#include <filesystem>
+
 #include "defines.hpp"
 #include "renderer/shader.hpp"
 #include "debug/logger.hpp"
@@ -71,6 +73,11 @@ namespace core
 		return bgfx::createShader(mem);
 	}
 
+	ShaderManager::ShaderManager(const std::string& directory)
+		: directory(directory)
+	{
+	}
+
 	void ShaderManager::loadAndAdd(const std::string& vertexShaderPath,
 		const std::string& fragmentShaderPath)
 	{
@@ -83,7 +90,7 @@ namespace core
 
 	void ShaderManager::add(const ref<Shader>& shader)
 	{
-		shaders[shader->getName()] = shader;
+		shaders[StringID(shader->getName())] = shader;
 	}
 
 	ref<Shader> ShaderManager::load(const std::string& vertexShaderPath,
@@ -95,8 +102,98 @@ namespace core
 		return shader;
 	}
 
-	ref<Shader> ShaderManager::get(const std::string& name)
+	ref<Shader> ShaderManager::get(const StringID& name) const
+	{
+		const ref<Shader>* shader = shaders.find(name);
+		return shader ? *shader : nullptr;
+	}
+
+	ref<Shader> ShaderManager::getVariant(const std::string& name,
+		const uint32_t& features)
+	{
+		const StringID id(name);
+		VariantSet& set = variants[id];
+		if (set.name.empty())
+		{
+			set.name = name;
+		}
+		return getVariant(id, features);
+	}
+
+	ref<Shader> ShaderManager::getVariant(const StringID& name,
+		const uint32_t& features)
 	{
-		return shaders[name];
+		VariantSet* set = variants.find(name);
+		if (!set)
+		{
+			Logger::logWarn("Shader '%s' was never asked for by name",
+				name.getString());
+			return nullptr;
+		}
+
+		// Offset by one since a zero key marks an empty slot
+		const StringID key(static_cast<uint64_t>(features) + 1);
+		if (const ref<Shader>* shader = set->shaders.find(key))
+		{
+			return *shader;
+		}
+
+		ref<Shader> shader = loadVariant(set->name, features);
+		if (!shader && (features & ShaderFeatureMaterialMask))
+		{
+			shader = getVariant(name, features & ~ShaderFeatureMaterialMask);
+		}
+
+		set->shaders[key] = shader;
+		return shader;
+	}
+
+	std::string ShaderManager::getVariantName(const std::string& name,
+		const uint32_t& features)
+	{
+		static const char* suffixes[] =
+		{
+			"-unlit",
+			"-basecolormap",
+			"-twosided",
+			"-translucent",
+			"-packed",
+			"-instanced",
+			"-depth",
+		};
+
+		std::string variantName = name;
+		for (uint32_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++)
+		{
+			if (features & (1u << i))
+			{
+				variantName += suffixes[i];
+			}
+		}
+		return variantName;
+	}
+
+	ref<Shader> ShaderManager::loadVariant(const std::string& name,
+		const uint32_t& features)
+	{
+		const std::string variantName = getVariantName(name, features);
+
+		// Already loaded up front
+		if (ref<Shader> shader = get(StringID(variantName)))
+		{
+			return shader;
+		}
+
+		const std::string vertexPath = directory + variantName + "-vert.bin";
+		const std::string fragmentPath = directory + variantName + "-frag.bin";
+		if (!std::filesystem::exists(vertexPath) ||
+			!std::filesystem::exists(fragmentPath))
+		{
+			return nullptr;
+		}
+
+		ref<Shader> shader = load(vertexPath, fragmentPath);
+		add(shader);
+		return shader;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,383 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include <bx/math.h>
+
+#include "math.hpp"
+#include "defines.hpp"
+#include "string_id.hpp"
+#include "jobs/job_system.hpp"
+#include "renderer/shadow_maps.hpp"
+#include "renderer/renderer.hpp"
+#include "renderer/uniform_registry.hpp"
+
+namespace core
+{
+	/*
+	 * Cascade bounds snap to this fraction of the split size, rounded to a
+	 * power of two so the grid itself does not move with float noise
+	 */
+	static constexpr float snapSteps = 16.0f;
+
+	/*
+	 * Resolves UINT16_MAX to the last views bgfx has
+	 */
+	static ShadowMapsParams resolveViews(ShadowMapsParams params)
+	{
+		if (params.firstViewID == UINT16_MAX)
+		{
+			params.firstViewID = static_cast<uint16_t>(
+				bgfx::getCaps()->limits.maxViews - params.cascadeCount);
+		}
+		return params;
+	}
+
+	ShadowMaps::ShadowMaps(const ShadowMapsParams& params)
+		: params(resolveViews(params)), tilesPerRow(1), tileSize(0)
+		, cascadeKeys(), pendingKeys()
+		, s_shadowMap(BGFX_INVALID_HANDLE), u_shadowMatrices(BGFX_INVALID_HANDLE)
+		, u_shadowSplits(BGFX_INVALID_HANDLE), u_shadowParams(BGFX_INVALID_HANDLE)
+		, shadowSplits(0.0f), shadowParams(0.0f)
+	{
+		ASSERT(params.cascadeCount > 0 && params.cascadeCount <= maxShadowCascades,
+			"Shadow cascade count is out of range");
+
+		// Views, cascades are drawn before every other view
+		const uint32_t maxViews = bgfx::getCaps()->limits.maxViews;
+		const uint16_t firstViewID = getParams().firstViewID;
+		ASSERT(firstViewID + params.cascadeCount <= maxViews,
+			"Shadow cascade views are out of range");
+
+		std::vector<bgfx::ViewId> order;
+		order.reserve(maxViews);
+		for (uint32_t i = 0; i < params.cascadeCount; i++)
+		{
+			order.push_back(static_cast<bgfx::ViewId>(firstViewID + i));
+		}
+		for (uint32_t i = 0; i < maxViews; i++)
+		{
+			if (!isShadowView(static_cast<uint16_t>(i)))
+			{
+				order.push_back(static_cast<bgfx::ViewId>(i));
+			}
+		}
+		bgfx::setViewOrder(0, static_cast<uint16_t>(maxViews), order.data());
+
+		// Atlas, cascades are square tiles in a grid
+		tilesPerRow = (params.cascadeCount > 1) ? 2 : 1;
+		tileSize = params.atlasSize / tilesPerRow;
+
+		Texture2DParams atlasParams;
+		atlasParams.format = params.format;
+		atlasParams.isRenderTarget = true;
+		atlasParams.compare = true;
+		atlasParams.width = params.atlasSize;
+		atlasParams.height = params.atlasSize;
+		atlas = Texture2D::create(nullptr, atlasParams);
+		framebuffer = Framebuffer::create({ atlas });
+
+		// Uniforms
+		s_shadowMap = UniformRegistry::get("s_shadowMap", bgfx::UniformType::Sampler);
+		u_shadowMatrices = UniformRegistry::get("u_shadowMatrices",
+			bgfx::UniformType::Mat4, maxShadowCascades);
+		u_shadowSplits = UniformRegistry::get("u_shadowSplits", bgfx::UniformType::Vec4);
+		u_shadowParams = UniformRegistry::get("u_shadowParams", bgfx::UniformType::Vec4);
+
+		for (glm::mat4& matrix : shadowMatrices)
+		{
+			matrix = glm::mat4(1.0f);
+		}
+	}
+
+	ShadowMaps::~ShadowMaps()
+	{
+		// Back to drawing views in id order
+		bgfx::setViewOrder();
+	}
+
+	void ShadowMaps::update(const Camera& camera, const glm::vec3& lightDirection,
+		const SceneBVH& scene)
+	{
+		ASSERT(glm::dot(lightDirection, lightDirection) > 0.0f,
+			"Light direction is zero");
+
+		// Light space, only rotated so snapping in it is stable
+		const glm::vec3 direction = glm::normalize(lightDirection);
+		const bx::Vec3 up = (std::abs(direction.y) > 0.99f) ?
+			bx::Vec3(1.0f, 0.0f, 0.0f) : bx::Vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 lightView;
+		bx::mtxLookAt(&lightView[0][0], { 0.0f, 0.0f, 0.0f },
+			{ direction.x, direction.y, direction.z }, up);
+
+		// Practical split scheme, a blend of logarithmic and uniform splits
+		const float zNear = camera.getParams().clipNear;
+		const float zFar = std::min(camera.getParams().clipFar, params.maxDistance);
+		float splits[maxShadowCascades + 1];
+		splits[0] = zNear;
+		for (uint32_t i = 1; i <= params.cascadeCount; i++)
+		{
+			const float t = static_cast<float>(i) / params.cascadeCount;
+			const float logarithmic = zNear * std::pow(zFar / zNear, t);
+			const float uniform = zNear + (zFar - zNear) * t;
+			splits[i] = params.splitLambda * logarithmic +
+				(1.0f - params.splitLambda) * uniform;
+		}
+
+		// Cascades cull their casters independently
+		JobSystem::parallelFor(params.cascadeCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				fitCascade(i, camera, lightView, splits[i], splits[i + 1], scene);
+			}
+		});
+
+		// Only cascades whose bounds or casters changed are drawn again
+		for (uint32_t i = 0; i < params.cascadeCount; i++)
+		{
+			ShadowCascade& cascade = cascades[i];
+			cascade.redrawn = pendingKeys[i] != cascadeKeys[i];
+			if (cascade.redrawn)
+			{
+				drawCascade(i, scene);
+				cascadeKeys[i] = pendingKeys[i];
+			}
+			else
+			{
+				bgfx::setViewClear(params.firstViewID + i, BGFX_CLEAR_NONE);
+			}
+
+			shadowMatrices[i] = cascade.shadowMatrix;
+			shadowSplits[i] = cascade.splitFar;
+		}
+
+		shadowParams = glm::vec4(params.cascadeCount,
+			1.0f / params.atlasSize, 0.0f, 0.0f);
+	}
+
+	/*
+	 * Fits a cascade to the camera frustum between two depths and finds its
+	 * casters. The box is snapped outward in light space, its near plane is
+	 * pulled back to the closest caster so casters outside the view still
+	 * cast into it
+	 */
+	void ShadowMaps::fitCascade(const uint32_t& index, const Camera& camera,
+		const glm::mat4& lightView, const float& splitNear, const float& splitFar,
+		const SceneBVH& scene)
+	{
+		const bool homogeneousDepth = bgfx::getCaps()->homogeneousDepth;
+		const glm::mat4& proj = camera.getProjectionMatrix();
+		const glm::mat4 invView = glm::inverse(camera.getViewMatrix());
+
+		// Corners of the split in world space
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			const float depth = (i & 4) ? splitFar : splitNear;
+			const glm::vec4 corner((i & 1 ? 1.0f : -1.0f) * depth / proj[0][0],
+				(i & 2 ? 1.0f : -1.0f) * depth / proj[1][1], depth, 1.0f);
+			corners[i] = glm::vec3(invView * corner);
+			center += corners[i] * 0.125f;
+		}
+
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+		{
+			radius = std::max(radius, glm::length(corner - center));
+		}
+		const float snap = std::exp2(std::ceil(std::log2(
+			std::max(radius * 2.0f / snapSteps, 1e-4f))));
+
+		// Tight bounds of the split in light space
+		glm::vec3 boxMin(CORE_BIG_NUMBER);
+		glm::vec3 boxMax(-CORE_BIG_NUMBER);
+		for (const glm::vec3& corner : corners)
+		{
+			const glm::vec3 position = glm::vec3(lightView * glm::vec4(corner, 1.0f));
+			boxMin = glm::min(boxMin, position);
+			boxMax = glm::max(boxMax, position);
+		}
+		boxMin = glm::floor(boxMin / snap) * snap;
+		boxMax = glm::ceil(boxMax / snap) * snap;
+
+		// Casters anywhere between the light and the split
+		glm::mat4 lightProj;
+		bx::mtxOrtho(&lightProj[0][0], boxMin.x, boxMax.x, boxMin.y, boxMax.y,
+			boxMin.z - params.maxDistance, boxMax.z, 0.0f, homogeneousDepth);
+		const Frustum frustum = math::extractFrustum(lightProj * lightView,
+			homogeneousDepth);
+
+		std::vector<uint32_t>& cascadeCasters = casters[index];
+		cascadeCasters.clear();
+		scene.queryFrustum(frustum, cascadeCasters);
+
+		float casterNear = boxMin.z;
+		uint32_t kept = 0;
+		for (const uint32_t proxyID : cascadeCasters)
+		{
+			const ref<Material> material = scene.getMesh(proxyID)->getMaterial();
+			if (!material || !material->getParams().castShadow)
+			{
+				continue;
+			}
+			cascadeCasters[kept++] = proxyID;
+
+			const AABB bounds = math::transformAABB(scene.getWorldBounds(proxyID),
+				lightView);
+			casterNear = std::min(casterNear, bounds.min.z);
+		}
+		cascadeCasters.resize(kept);
+		casterNear = std::max(std::floor(casterNear / snap) * snap,
+			boxMin.z - params.maxDistance);
+
+		ShadowCascade& cascade = cascades[index];
+		bx::mtxOrtho(&lightProj[0][0], boxMin.x, boxMax.x, boxMin.y, boxMax.y,
+			casterNear, boxMax.z, 0.0f, homogeneousDepth);
+		cascade.view = lightView;
+		cascade.proj = lightProj;
+		cascade.splitFar = splitFar;
+		cascade.casterCount = kept;
+
+		// Clip space to the cascade's tile of the atlas, texture rows start
+		// at the bottom where the origin is bottom left
+		const float scale = 1.0f / tilesPerRow;
+		const float column = static_cast<float>(index % tilesPerRow);
+		const float row = static_cast<float>(index / tilesPerRow);
+		glm::mat4 toAtlas(1.0f);
+		toAtlas[0][0] = 0.5f * scale;
+		toAtlas[3][0] = (column + 0.5f) * scale;
+		if (bgfx::getCaps()->originBottomLeft)
+		{
+			toAtlas[1][1] = 0.5f * scale;
+			toAtlas[3][1] = 1.0f - (row + 0.5f) * scale;
+		}
+		else
+		{
+			toAtlas[1][1] = -0.5f * scale;
+			toAtlas[3][1] = (row + 0.5f) * scale;
+		}
+		if (homogeneousDepth)
+		{
+			toAtlas[2][2] = 0.5f;
+			toAtlas[3][2] = 0.5f;
+		}
+		cascade.shadowMatrix = toAtlas * lightProj * lightView;
+
+		// What the cached map depends on
+		uint64_t key = hashFNV1a(reinterpret_cast<const char*>(&lightView[0][0]),
+			sizeof(glm::mat4));
+		key = hashFNV1a(reinterpret_cast<const char*>(&lightProj[0][0]),
+			sizeof(glm::mat4), key);
+		for (const uint32_t proxyID : cascadeCasters)
+		{
+			const Mesh* mesh = scene.getMesh(proxyID).get();
+			key = hashFNV1a(reinterpret_cast<const char*>(&proxyID),
+				sizeof(proxyID), key);
+			key = hashFNV1a(reinterpret_cast<const char*>(&mesh),
+				sizeof(mesh), key);
+			key = hashFNV1a(reinterpret_cast<const char*>(
+				&scene.getWorldMatrix(proxyID)[0][0]), sizeof(glm::mat4), key);
+		}
+		pendingKeys[index] = key ? key : 1;
+	}
+
+	void ShadowMaps::drawCascade(const uint32_t& index, const SceneBVH& scene)
+	{
+		const ShadowCascade& cascade = cascades[index];
+		const bgfx::ViewId viewID = params.firstViewID + index;
+
+		bgfx::setViewRect(viewID, (index % tilesPerRow) * tileSize,
+			(index / tilesPerRow) * tileSize, tileSize, tileSize);
+		bgfx::setViewFrameBuffer(viewID, framebuffer->handle);
+		bgfx::setViewClear(viewID, BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+		bgfx::setViewTransform(viewID, &cascade.view[0][0], &cascade.proj[0][0]);
+		bgfx::touch(viewID);
+
+		ref<ShaderManager> shaderManager = Renderer::getShaderManager();
+		bgfx::Encoder* encoder = Renderer::beginEncoder();
+		for (const uint32_t proxyID : casters[index])
+		{
+			const ref<Mesh>& mesh = scene.getMesh(proxyID);
+			const Material& material = *mesh->getMaterial();
+
+			// Depth variants only vary by vertex input
+			const bool packed = mesh->getVertexFormat() != VertexFormat::Float;
+			const ref<Shader> shader = shaderManager->getVariant(
+				material.getShaderID(),
+				ShaderFeatureDepthOnly |
+				(packed ? static_cast<uint32_t>(ShaderFeaturePacked) : 0u));
+			if (!shader)
+			{
+				static bool warned = false;
+				if (!warned)
+				{
+					Logger::logWarn("Shader '%s' has no depth variant, casters "
+						"using it are skipped", material.getShaderName().c_str());
+					warned = true;
+				}
+				continue;
+			}
+
+			const glm::mat4& matrix = scene.getWorldMatrix(proxyID);
+			if (mesh->getVertexFormat() == VertexFormat::Quantized)
+			{
+				const glm::mat4 decodedMatrix = matrix * mesh->getDecodeMatrix();
+				encoder->setTransform(&decodedMatrix[0][0]);
+			}
+			else
+			{
+				encoder->setTransform(&matrix[0][0]);
+			}
+
+			encoder->setVertexBuffer(0, mesh->getVertexArray()->vertexBuffer->handle);
+			encoder->setIndexBuffer(mesh->getVertexArray()->indexBuffer->handle);
+			encoder->setState(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS |
+				(material.getParams().twoSided ? 0 : BGFX_STATE_CULL_CCW));
+			encoder->submit(viewID, shader->handle);
+		}
+		Renderer::endEncoder(encoder);
+	}
+
+	void ShadowMaps::bind(bgfx::Encoder* encoder, const bool& uploadValues) const
+	{
+		encoder->setTexture(4, s_shadowMap, atlas->handle);
+
+		if (uploadValues)
+		{
+			encoder->setUniform(u_shadowMatrices, &shadowMatrices[0][0][0],
+				maxShadowCascades);
+			encoder->setUniform(u_shadowSplits, &shadowSplits);
+			encoder->setUniform(u_shadowParams, &shadowParams);
+		}
+	}
+
+	void ShadowMaps::invalidate()
+	{
+		for (uint64_t& key : cascadeKeys)
+		{
+			key = 0;
+		}
+	}
+
+	ref<ShadowMaps> ShadowMaps::create(const ShadowMapsParams& params)
+	{
+		return makeRef<ShadowMaps>(params);
+	}
+}
@@ -3,15 +3,20 @@
 #include "crpch.hpp"
 
 #include <bgfx/bgfx.h>
+#include <bimg/bimg.h>
+#include <bx/allocator.h>
 
 #include "defines.hpp"
 #include "renderer/texture.hpp"
+#include "renderer/buffers.hpp"
+#include "io/mapped_file.hpp"
 #include "debug/logger.hpp"
 
 namespace core
 {
 	Texture2D::Texture2D(const uint8_t* data, const Texture2DParams& params)
-		: params(params), handle(BGFX_INVALID_HANDLE)
+		: params(params), handle(BGFX_INVALID_HANDLE), ownsHandle(true)
+		, streamID(UINT32_MAX)
 	{
 		if (params.width <= 0 || params.height <= 0)
 		{
@@ -19,10 +24,7 @@ namespace core
 		}
 
 		// Flags
-		uint64_t flags = 0
-			| (params.nearest ? (BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT) : (BGFX_SAMPLER_MIN_ANISOTROPIC | BGFX_SAMPLER_MAG_ANISOTROPIC))
-			| (params.isRenderTarget ? BGFX_TEXTURE_RT : 0)
-			| (params.stretch ? BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP : 0);
+		const uint64_t flags = getFlags();
 		
 		// Check if texture can be made
 		if (!bgfx::isTextureValid(0, false, 1, toBGFX(params.format), BGFX_TEXTURE_RT))
@@ -58,10 +60,21 @@ namespace core
 		}
 	}
 
+	Texture2D::Texture2D(const Texture2DParams& params,
+		const bgfx::TextureHandle handle, const bool& ownsHandle)
+		: params(params), handle(handle), ownsHandle(ownsHandle)
+		, streamID(UINT32_MAX)
+	{
+	}
+
 	Texture2D::~Texture2D()
 	{
-		// Destroy our texture handle
-		bgfx::destroy(handle);
+		// Destroy our texture handle, placeholders belong to someone else.
+		// Failed loads never got one
+		if (ownsHandle && bgfx::isValid(handle))
+		{
+			bgfx::destroy(handle);
+		}
 	}
 
 	ref<Texture2D> Texture2D::create(const uint8_t* data,
@@ -70,6 +83,81 @@ namespace core
 		return makeRef<Texture2D>(data, params);
 	}
 
+	static void releaseImage(void*, void* userData)
+	{
+		bimg::imageFree(static_cast<bimg::ImageContainer*>(userData));
+	}
+
+	ref<Texture2D> Texture2D::load(const std::string& filename,
+		const Texture2DParams& params)
+	{
+		const ref<MappedFile> file = MappedFile::create(filename);
+		if (!file)
+		{
+			Logger::logError("Failed to open texture %s", filename.c_str());
+			return nullptr;
+		}
+
+		bimg::ImageContainer image;
+		if (!bimg::imageParse(image, file->getData(),
+			static_cast<uint32_t>(file->getSize())) ||
+			image.m_depth != 1 || image.m_numLayers != 1 || image.m_cubeMap)
+		{
+			Logger::logError("Texture %s is not a 2D dds or ktx texture",
+				filename.c_str());
+			return nullptr;
+		}
+
+		ref<Texture2D> texture(new Texture2D(params, BGFX_INVALID_HANDLE, true));
+		texture->params.width = static_cast<uint16_t>(image.m_width);
+		texture->params.height = static_cast<uint16_t>(image.m_height);
+		texture->params.hasMips = image.m_numMips > 1;
+
+		const bgfx::TextureFormat::Enum format =
+			static_cast<bgfx::TextureFormat::Enum>(image.m_format);
+		const uint64_t flags = texture->getFlags();
+
+		// bgfx reads dds and ktx itself, upload straight from the mapping
+		if (bgfx::isTextureValid(0, false, 1, format, flags))
+		{
+			texture->params.format = texture->fromBGFX(format);
+			texture->handle = bgfx::createTexture(shareMemory(file->getData(),
+				static_cast<uint32_t>(file->getSize()), file), flags);
+			return texture;
+		}
+
+		// Decode formats the renderer lacks, mips included
+		static bx::DefaultAllocator allocator;
+		bimg::ImageContainer* decoded = bimg::imageConvert(&allocator,
+			bimg::TextureFormat::RGBA8, file->getData(),
+			static_cast<uint32_t>(file->getSize()));
+		if (!decoded)
+		{
+			Logger::logError("Failed to decode texture %s", filename.c_str());
+			return nullptr;
+		}
+
+		Logger::logWarn("Texture format of %s is unsupported, decoded to RGBA8",
+			filename.c_str());
+
+		texture->params.format = Texture2DFormat::RGBA8;
+		texture->params.channels = 4;
+		texture->handle = bgfx::createTexture2D(texture->params.width,
+			texture->params.height, texture->params.hasMips, 1,
+			bgfx::TextureFormat::RGBA8, flags, bgfx::makeRef(decoded->m_data,
+				decoded->m_size, releaseImage, decoded));
+		return texture;
+	}
+
+	uint64_t Texture2D::getFlags() const
+	{
+		return 0
+			| (params.nearest ? (BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT) : (BGFX_SAMPLER_MIN_ANISOTROPIC | BGFX_SAMPLER_MAG_ANISOTROPIC))
+			| (params.isRenderTarget ? BGFX_TEXTURE_RT : 0)
+			| (params.compare ? BGFX_SAMPLER_COMPARE_LEQUAL : 0)
+			| (params.stretch ? BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP : 0);
+	}
+
 	bgfx::TextureFormat::Enum Texture2D::toBGFX(Texture2DFormat format)
 	{
 		switch (format)
@@ -188,8 +276,35 @@ namespace core
 			return bgfx::TextureFormat::D32F;
 		case core::Texture2DFormat::D0S8:
 			return bgfx::TextureFormat::D0S8;
+		case core::Texture2DFormat::BC1:
+			return bgfx::TextureFormat::BC1;
+		case core::Texture2DFormat::BC3:
+			return bgfx::TextureFormat::BC3;
+		case core::Texture2DFormat::BC5:
+			return bgfx::TextureFormat::BC5;
+		case core::Texture2DFormat::BC7:
+			return bgfx::TextureFormat::BC7;
+		case core::Texture2DFormat::ETC2:
+			return bgfx::TextureFormat::ETC2;
+		case core::Texture2DFormat::ETC2A:
+			return bgfx::TextureFormat::ETC2A;
+		case core::Texture2DFormat::ASTC4x4:
+			return bgfx::TextureFormat::ASTC4x4;
 		default:
 			return bgfx::TextureFormat::RGBA8;
 		}
 	}
+
+	Texture2DFormat Texture2D::fromBGFX(const bgfx::TextureFormat::Enum format)
+	{
+		for (uint32_t i = 0; i <= static_cast<uint32_t>(Texture2DFormat::D0S8); i++)
+		{
+			const Texture2DFormat candidate = static_cast<Texture2DFormat>(i);
+			if (toBGFX(candidate) == format)
+			{
+				return candidate;
+			}
+		}
+		return Texture2DFormat::RGBA8;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <bgfx/bgfx.h>
+
+#include "defines.hpp"
+#include "utils.hpp"
+#include "renderer/texture_atlas.hpp"
+#include "debug/logger.hpp"
+
+namespace core
+{
+	TextureAtlas::TextureAtlas(const TextureAtlasParams& params)
+		: params(params)
+	{
+	}
+
+	bool TextureAtlas::add(const uint8_t* data, const uint16_t& width,
+		const uint16_t& height, AtlasRegion& outRegion)
+	{
+		ASSERT(data, "Texture data is null");
+
+		const uint16_t padding = params.padding;
+		const uint32_t paddedWidth = width + padding * 2;
+		const uint32_t paddedHeight = height + padding * 2;
+		if (paddedWidth > params.pageSize || paddedHeight > params.pageSize)
+		{
+			Logger::logWarn("Texture of %ux%u does not fit in a %u atlas page",
+				width, height, params.pageSize);
+			return false;
+		}
+
+		// First page with room, or a new one
+		uint16_t x = 0, y = 0;
+		uint16_t pageIndex = 0;
+		while (pageIndex < pages.size() && !allocate(pages[pageIndex],
+			static_cast<uint16_t>(paddedWidth), static_cast<uint16_t>(paddedHeight), x, y))
+		{
+			pageIndex++;
+		}
+
+		if (pageIndex == pages.size())
+		{
+			Texture2DParams pageParams;
+			pageParams.format = Texture2DFormat::RGBA8;
+			pageParams.width = params.pageSize;
+			pageParams.height = params.pageSize;
+			pageParams.channels = 4;
+			pageParams.nearest = params.nearest;
+
+			Page page;
+			page.texture = Texture2D::create(nullptr, pageParams);
+			pages.push_back(std::move(page));
+
+			allocate(pages.back(), static_cast<uint16_t>(paddedWidth),
+				static_cast<uint16_t>(paddedHeight), x, y);
+		}
+
+		// Copy with the edge pixels repeated into the padding, so filtering
+		// never blends in neighbours
+		const bgfx::Memory* memory = bgfx::alloc(paddedWidth * paddedHeight * 4);
+		for (uint32_t row = 0; row < paddedHeight; row++)
+		{
+			const uint32_t srcRow = static_cast<uint32_t>(std::clamp(
+				static_cast<int32_t>(row) - padding, 0, height - 1));
+			for (uint32_t column = 0; column < paddedWidth; column++)
+			{
+				const uint32_t srcColumn = static_cast<uint32_t>(std::clamp(
+					static_cast<int32_t>(column) - padding, 0, width - 1));
+				std::memcpy(memory->data + (row * paddedWidth + column) * 4,
+					data + (srcRow * width + srcColumn) * 4, 4);
+			}
+		}
+
+		bgfx::updateTexture2D(pages[pageIndex].texture->handle, 0, 0, x, y,
+			static_cast<uint16_t>(paddedWidth), static_cast<uint16_t>(paddedHeight),
+			memory);
+
+		const float pageSize = static_cast<float>(params.pageSize);
+		outRegion.page = pageIndex;
+		outRegion.uvOffset = glm::vec2(x + padding, y + padding) / pageSize;
+		outRegion.uvScale = glm::vec2(width, height) / pageSize;
+		return true;
+	}
+
+	bool TextureAtlas::add(const std::string& filename, AtlasRegion& outRegion,
+		const bool& yFlip)
+	{
+		Texture2DParams textureParams;
+		uint8_t* bytes = utils::decodeTexture2D(filename, textureParams, yFlip);
+		if (!bytes)
+		{
+			Logger::logError("Failed to decode texture %s", filename.c_str());
+			return false;
+		}
+
+		const bool added = add(bytes, textureParams.width, textureParams.height,
+			outRegion);
+		utils::freeTexture2D(bytes);
+		return added;
+	}
+
+	bool TextureAtlas::allocate(Page& page, const uint16_t& width,
+		const uint16_t& height, uint16_t& outX, uint16_t& outY)
+	{
+		// Shortest shelf that fits wastes the least height
+		Shelf* best = nullptr;
+		for (Shelf& shelf : page.shelves)
+		{
+			if (shelf.height >= height && shelf.x + width <= params.pageSize &&
+				(!best || shelf.height < best->height))
+			{
+				best = &shelf;
+			}
+		}
+
+		if (!best)
+		{
+			if (page.nextShelfY + height > params.pageSize)
+			{
+				return false;
+			}
+
+			page.shelves.push_back({ page.nextShelfY, height, 0 });
+			page.nextShelfY += height;
+			best = &page.shelves.back();
+		}
+
+		outX = best->x;
+		outY = best->y;
+		best->x += width;
+		return true;
+	}
+
+	ref<TextureAtlas> TextureAtlas::create(const TextureAtlasParams& params)
+	{
+		return makeRef<TextureAtlas>(params);
+	}
+}
@@ -0,0 +1,636 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <bgfx/bgfx.h>
+
+#include "defines.hpp"
+#include "utils.hpp"
+#include "renderer/texture_loader.hpp"
+#include "renderer/buffers.hpp"
+#include "jobs/job_system.hpp"
+#include "debug/logger.hpp"
+
+namespace core
+{
+	/*
+	 * Decoded pixels, shared with bgfx until every row has been uploaded
+	 */
+	struct DecodedPixels
+	{
+		explicit DecodedPixels(uint8_t* bytes) : bytes(bytes) {}
+		~DecodedPixels() { utils::freeTexture2D(bytes); }
+
+		DecodedPixels(const DecodedPixels&) = delete;
+		DecodedPixels& operator=(const DecodedPixels&) = delete;
+
+		uint8_t* bytes;
+	};
+
+	/*
+	 * Every mip level of a streamed texture stored back to back, largest
+	 * first, so the levels from any mip down to 1x1 are one range
+	 */
+	struct MipChain
+	{
+		std::vector<uint8_t> bytes;
+		std::vector<uint32_t> offsets;
+		std::vector<uint16_t> widths;
+		std::vector<uint16_t> heights;
+
+		[[nodiscard]] uint8_t getLevelCount() const
+		{
+			return static_cast<uint8_t>(offsets.size());
+		}
+
+		// Bytes of the levels from level down to 1x1
+		[[nodiscard]] uint32_t getSize(const uint8_t level) const
+		{
+			return static_cast<uint32_t>(bytes.size()) - offsets[level];
+		}
+	};
+
+	struct TextureRequest
+	{
+		std::string filename;
+		bool yFlip;
+		bool streamed;
+		std::weak_ptr<Texture2D> texture;
+	};
+
+	struct DecodedTexture
+	{
+		std::weak_ptr<Texture2D> texture;
+		ref<DecodedPixels> pixels; // nullptr if decoding failed
+		ref<MipChain> mips; // Streamed textures only
+		Texture2DParams params;
+	};
+
+	struct StreamedTexture
+	{
+		std::weak_ptr<Texture2D> texture;
+		ref<MipChain> mips;
+		Texture2DParams params;
+
+		uint8_t residentLevel = 0; // Largest mip on the GPU
+		uint8_t minLevel = 0; // Smallest resident mip allowed
+		uint8_t requestedLevel = 0; // Largest mip asked for since the last update
+		uint64_t lastUsedFrame = 0;
+		uint32_t residentBytes = 0;
+	};
+
+	/*
+	 * Texture being uploaded in rows over several frames
+	 */
+	struct TextureUpload
+	{
+		DecodedTexture decoded;
+		bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+		uint16_t nextRow = 0;
+	};
+
+	struct TextureLoaderData
+	{
+		TextureLoaderParams params;
+		ref<Texture2D> placeholder;
+
+		JobCounter decoding; // Decode jobs, one per request
+		std::mutex mutex;
+		std::deque<TextureRequest> requests;
+		std::deque<DecodedTexture> decoded;
+		bool stopping = false;
+
+		std::atomic<uint32_t> pending = 0;
+		bool uploading = false;
+		TextureUpload upload;
+
+		std::vector<StreamedTexture> streams;
+		std::vector<uint32_t> freeStreams;
+		std::vector<uint32_t> streamOrder;
+		uint64_t residentBytes = 0;
+		uint64_t frame = 1;
+	};
+	static TextureLoaderData* data;
+
+	static ref<MipChain> buildMipChain(const uint8_t* pixels,
+		const Texture2DParams& params)
+	{
+		const uint32_t channels = params.channels;
+		ref<MipChain> chain = makeRef<MipChain>();
+
+		uint32_t size = 0;
+		uint16_t width = params.width;
+		uint16_t height = params.height;
+		while (true)
+		{
+			chain->offsets.push_back(size);
+			chain->widths.push_back(width);
+			chain->heights.push_back(height);
+			size += width * height * channels;
+
+			if (width == 1 && height == 1)
+			{
+				break;
+			}
+			width = std::max<uint16_t>(width / 2, 1);
+			height = std::max<uint16_t>(height / 2, 1);
+		}
+
+		chain->bytes.resize(size);
+		std::memcpy(chain->bytes.data(), pixels,
+			params.width * params.height * channels);
+
+		// Box filter every level from the one above, odd edges reuse the
+		// last row or column
+		for (uint8_t level = 1; level < chain->getLevelCount(); level++)
+		{
+			const uint8_t* src = chain->bytes.data() + chain->offsets[level - 1];
+			uint8_t* dst = chain->bytes.data() + chain->offsets[level];
+			const uint32_t srcWidth = chain->widths[level - 1];
+			const uint32_t srcHeight = chain->heights[level - 1];
+
+			for (uint32_t y = 0; y < chain->heights[level]; y++)
+			{
+				const uint32_t y0 = std::min(y * 2, srcHeight - 1);
+				const uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+				for (uint32_t x = 0; x < chain->widths[level]; x++)
+				{
+					const uint32_t x0 = std::min(x * 2, srcWidth - 1);
+					const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+					for (uint32_t c = 0; c < channels; c++)
+					{
+						const uint32_t sum =
+							src[(y0 * srcWidth + x0) * channels + c] +
+							src[(y0 * srcWidth + x1) * channels + c] +
+							src[(y1 * srcWidth + x0) * channels + c] +
+							src[(y1 * srcWidth + x1) * channels + c];
+						dst[(y * chain->widths[level] + x) * channels + c] =
+							static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+		}
+
+		return chain;
+	}
+
+	/*
+	 * Decode job, takes the oldest request so textures finish roughly in
+	 * the order they were asked for
+	 */
+	static void decodeTexture()
+	{
+		TextureRequest request;
+		{
+			std::lock_guard<std::mutex> lock(data->mutex);
+			if (data->stopping || data->requests.empty())
+			{
+				return;
+			}
+
+			request = std::move(data->requests.front());
+			data->requests.pop_front();
+		}
+
+		DecodedTexture decoded;
+		decoded.texture = request.texture;
+
+		// Nobody holds the texture anymore, skip decoding it
+		if (const ref<Texture2D> texture = request.texture.lock())
+		{
+			decoded.params = texture->getParams();
+			uint8_t* bytes = utils::decodeTexture2D(request.filename,
+				decoded.params, request.yFlip);
+			if (bytes && request.streamed)
+			{
+				decoded.mips = buildMipChain(bytes, decoded.params);
+				utils::freeTexture2D(bytes);
+			}
+			else if (bytes)
+			{
+				decoded.pixels = makeRef<DecodedPixels>(bytes);
+			}
+			else
+			{
+				Logger::logError("Failed to decode texture %s",
+					request.filename.c_str());
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(data->mutex);
+		data->decoded.push_back(std::move(decoded));
+	}
+
+	void TextureLoader::init(const TextureLoaderParams& params)
+	{
+		ASSERT(!data, "Texture loader is already initialized");
+		data = new TextureLoaderData();
+		data->params = params;
+
+		Texture2DParams placeholderParams;
+		uint8_t* bytes = utils::loadTexture2D(params.placeholderFilename,
+			placeholderParams);
+		data->placeholder = Texture2D::create(bytes, placeholderParams);
+	}
+
+	void TextureLoader::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(data->mutex);
+			data->stopping = true;
+		}
+
+		// Decode jobs that have not started return right away
+		JobSystem::wait(data->decoding);
+
+		if (data->uploading && bgfx::isValid(data->upload.handle))
+		{
+			bgfx::destroy(data->upload.handle);
+		}
+
+		delete data;
+		data = nullptr;
+	}
+
+	ref<Texture2D> TextureLoader::queueTexture(const std::string& filename,
+		const Texture2DParams& params, const bool& yFlip, const bool& streamed)
+	{
+		ASSERT(data, "Texture loader is not initialized");
+
+		ref<Texture2D> texture(new Texture2D(params, data->placeholder->handle,
+			false));
+
+		{
+			std::lock_guard<std::mutex> lock(data->mutex);
+			data->requests.push_back({ filename, yFlip, streamed, texture });
+		}
+		data->pending++;
+		JobSystem::run(decodeTexture, &data->decoding);
+
+		return texture;
+	}
+
+	ref<Texture2D> TextureLoader::load(const std::string& filename,
+		const Texture2DParams& params, const bool& yFlip)
+	{
+		// Mips would need the whole chain, use loadStreamed for mips
+		Texture2DParams textureParams = params;
+		textureParams.hasMips = false;
+
+		return queueTexture(filename, textureParams, yFlip, false);
+	}
+
+	ref<Texture2D> TextureLoader::loadStreamed(const std::string& filename,
+		const Texture2DParams& params, const bool& yFlip)
+	{
+		Texture2DParams textureParams = params;
+		textureParams.hasMips = true;
+
+		return queueTexture(filename, textureParams, yFlip, true);
+	}
+
+	void TextureLoader::requestSize(const Texture2D& texture,
+		const float& screenSize)
+	{
+		if (!texture.isStreamed())
+		{
+			return;
+		}
+
+		StreamedTexture& stream = data->streams[texture.streamID];
+
+		// Level whose size matches the screen size, rounded towards sharper
+		const float ratio = static_cast<float>(std::max(stream.params.width,
+			stream.params.height)) / std::max(screenSize, 1.0f);
+		const uint8_t level = static_cast<uint8_t>(std::min(
+			std::max(std::floor(std::log2(ratio)), 0.0f),
+			static_cast<float>(stream.minLevel)));
+
+		stream.requestedLevel = std::min(stream.requestedLevel, level);
+		stream.lastUsedFrame = data->frame;
+	}
+
+	/*
+	 * Recreates the texture of a stream with level as its largest mip
+	 */
+	void TextureLoader::setResidentLevel(StreamedTexture& stream, Texture2D& texture,
+		const uint8_t level)
+	{
+		const MipChain& mips = *stream.mips;
+		const bgfx::TextureHandle handle = bgfx::createTexture2D(
+			mips.widths[level], mips.heights[level], true, 1,
+			texture.toBGFX(stream.params.format), texture.getFlags(),
+			shareMemory(mips.bytes.data() + mips.offsets[level],
+				mips.getSize(level), stream.mips));
+
+		if (texture.ownsHandle)
+		{
+			bgfx::destroy(texture.handle);
+		}
+		texture.handle = handle;
+		texture.ownsHandle = true;
+
+		data->residentBytes -= stream.residentBytes;
+		stream.residentLevel = level;
+		stream.residentBytes = mips.getSize(level);
+		data->residentBytes += stream.residentBytes;
+	}
+
+	/*
+	 * Drops high mips of the least recently used textures until bytes are
+	 * freed, textures drawn this frame only lose mips they did not ask for
+	 */
+	uint64_t TextureLoader::evictMips(const uint64_t bytes, const uint32_t keep)
+	{
+		uint64_t freed = 0;
+		for (const uint32_t id : data->streamOrder)
+		{
+			if (freed >= bytes)
+			{
+				break;
+			}
+
+			StreamedTexture& stream = data->streams[id];
+			const ref<Texture2D> texture = stream.texture.lock();
+			if (id == keep || !texture)
+			{
+				continue;
+			}
+
+			const uint8_t level = (stream.lastUsedFrame == data->frame) ?
+				stream.requestedLevel : stream.minLevel;
+			if (level <= stream.residentLevel)
+			{
+				continue;
+			}
+
+			const uint32_t before = stream.residentBytes;
+			setResidentLevel(stream, *texture, level);
+			freed += before - stream.residentBytes;
+		}
+		return freed;
+	}
+
+	void TextureLoader::startStream(const DecodedTexture& decoded, Texture2D& texture)
+	{
+		uint32_t id = 0;
+		if (!data->freeStreams.empty())
+		{
+			id = data->freeStreams.back();
+			data->freeStreams.pop_back();
+		}
+		else
+		{
+			id = static_cast<uint32_t>(data->streams.size());
+			data->streams.emplace_back();
+		}
+
+		StreamedTexture& stream = data->streams[id];
+		stream = StreamedTexture();
+		stream.texture = decoded.texture;
+		stream.mips = decoded.mips;
+		stream.params = decoded.params;
+
+		// Lowest detail allowed, starting point of the stream
+		const MipChain& mips = *stream.mips;
+		while (stream.minLevel + 1 < mips.getLevelCount() &&
+			std::max(mips.widths[stream.minLevel],
+				mips.heights[stream.minLevel]) > data->params.minStreamedSize)
+		{
+			stream.minLevel++;
+		}
+		stream.requestedLevel = stream.minLevel;
+		stream.lastUsedFrame = data->frame;
+
+		texture.params = decoded.params;
+		texture.streamID = id;
+		setResidentLevel(stream, texture, stream.minLevel);
+	}
+
+	/*
+	 * Moves streamed textures towards the mips requested last frame
+	 */
+	void TextureLoader::updateStreams(uint32_t& budget)
+	{
+		// Forget streams whose texture is gone
+		data->streamOrder.clear();
+		for (uint32_t id = 0; id < data->streams.size(); id++)
+		{
+			StreamedTexture& stream = data->streams[id];
+			if (!stream.mips)
+			{
+				continue;
+			}
+
+			if (stream.texture.expired())
+			{
+				data->residentBytes -= stream.residentBytes;
+				stream = StreamedTexture();
+				data->freeStreams.push_back(id);
+				continue;
+			}
+			data->streamOrder.push_back(id);
+		}
+
+		// Least recently used first
+		std::sort(data->streamOrder.begin(), data->streamOrder.end(),
+			[](const uint32_t a, const uint32_t b)
+			{
+				return data->streams[a].lastUsedFrame < data->streams[b].lastUsedFrame;
+			});
+
+		// Upgrade the most recently used textures first
+		for (auto it = data->streamOrder.rbegin(); it != data->streamOrder.rend(); ++it)
+		{
+			StreamedTexture& stream = data->streams[*it];
+			if (stream.lastUsedFrame != data->frame || budget == 0)
+			{
+				break;
+			}
+
+			if (stream.requestedLevel >= stream.residentLevel)
+			{
+				continue;
+			}
+
+			// One level per step, the texture is recreated with the whole
+			// chain below it, so the upload has to fit the remaining budget.
+			// Only the first upload of a frame may exceed it, or large mips
+			// would never stream in
+			const uint8_t level = stream.residentLevel - 1;
+			const uint32_t size = stream.mips->getSize(level);
+			if (size > budget && budget < data->params.uploadBudget)
+			{
+				continue;
+			}
+
+			const uint64_t growth = size - stream.residentBytes;
+			const uint64_t budgetLeft = data->params.residencyBudget -
+				std::min(data->residentBytes, data->params.residencyBudget);
+			if (growth > budgetLeft &&
+				evictMips(growth - budgetLeft, *it) < growth - budgetLeft)
+			{
+				continue;
+			}
+
+			setResidentLevel(stream, *stream.texture.lock(), level);
+			budget -= std::min(budget, size);
+		}
+
+		// The budget may have shrunk or the upgrades overshot
+		if (data->residentBytes > data->params.residencyBudget)
+		{
+			evictMips(data->residentBytes - data->params.residencyBudget, UINT32_MAX);
+		}
+
+		// Requests are gathered again while the next frame is drawn
+		data->frame++;
+		for (StreamedTexture& stream : data->streams)
+		{
+			stream.requestedLevel = stream.minLevel;
+		}
+	}
+
+	void TextureLoader::update()
+	{
+		uint32_t budget = data->params.uploadBudget;
+		uploadTextures(budget);
+		updateStreams(budget);
+	}
+
+	void TextureLoader::uploadTextures(uint32_t& budget)
+	{
+		bool uploaded = false;
+
+		while (budget > 0 || !uploaded)
+		{
+			// Start the next decoded texture
+			if (!data->uploading)
+			{
+				{
+					std::lock_guard<std::mutex> lock(data->mutex);
+					if (data->decoded.empty())
+					{
+						return;
+					}
+
+					data->upload = TextureUpload();
+					data->upload.decoded = std::move(data->decoded.front());
+					data->decoded.pop_front();
+				}
+
+				const ref<Texture2D> texture = data->upload.decoded.texture.lock();
+				const bool decoded = data->upload.decoded.pixels ||
+					data->upload.decoded.mips;
+				if (!decoded || !texture)
+				{
+					data->pending--;
+					continue;
+				}
+
+				// Streamed textures start at their lowest detail mips, which
+				// are small enough to upload at once
+				if (data->upload.decoded.mips)
+				{
+					startStream(data->upload.decoded, *texture);
+					budget -= std::min(budget,
+						data->streams[texture->streamID].residentBytes);
+					uploaded = true;
+					data->pending--;
+					continue;
+				}
+
+				data->uploading = true;
+			}
+
+			TextureUpload& upload = data->upload;
+			const ref<Texture2D> texture = upload.decoded.texture.lock();
+			const Texture2DParams& params = upload.decoded.params;
+
+			// Dropped mid upload
+			if (!texture)
+			{
+				if (bgfx::isValid(upload.handle))
+				{
+					bgfx::destroy(upload.handle);
+				}
+				data->uploading = false;
+				data->pending--;
+				continue;
+			}
+
+			const uint32_t pitch = params.width * params.channels;
+			const uint32_t remaining = params.height - upload.nextRow;
+			const uint32_t rows = std::min(remaining, std::max(budget / pitch, 1u));
+			const uint8_t* pixels = upload.decoded.pixels->bytes +
+				static_cast<size_t>(upload.nextRow) * pitch;
+			const bgfx::Memory* memory = shareMemory(pixels, rows * pitch,
+				upload.decoded.pixels);
+
+			// Fits in one go, create an immutable texture with the data
+			if (upload.nextRow == 0 && rows == params.height)
+			{
+				upload.handle = bgfx::createTexture2D(params.width,
+					params.height, false, 1, texture->toBGFX(params.format),
+					texture->getFlags(), memory);
+			}
+			else
+			{
+				if (upload.nextRow == 0)
+				{
+					upload.handle = bgfx::createTexture2D(params.width,
+						params.height, false, 1, texture->toBGFX(params.format),
+						texture->getFlags());
+				}
+
+				bgfx::updateTexture2D(upload.handle, 0, 0, 0, upload.nextRow,
+					params.width, static_cast<uint16_t>(rows), memory);
+			}
+
+			upload.nextRow += static_cast<uint16_t>(rows);
+			budget -= std::min(budget, rows * pitch);
+			uploaded = true;
+
+			// Swap the placeholder for the real texture
+			if (upload.nextRow == params.height)
+			{
+				texture->params = params;
+				texture->handle = upload.handle;
+				texture->ownsHandle = true;
+
+				data->uploading = false;
+				data->pending--;
+			}
+		}
+	}
+
+	uint32_t TextureLoader::getPendingCount()
+	{
+		return data ? data->pending.load() : 0;
+	}
+
+	uint64_t TextureLoader::getResidentBytes()
+	{
+		return data ? data->residentBytes : 0;
+	}
+}
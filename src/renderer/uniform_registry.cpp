@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include "defines.hpp"
+#include "renderer/uniform_registry.hpp"
+
+namespace core
+{
+	struct RegisteredUniform
+	{
+		bgfx::UniformHandle handle;
+		bgfx::UniformType::Enum type;
+		uint16_t count;
+	};
+
+	static std::unordered_map<std::string, RegisteredUniform> uniforms;
+
+	bgfx::UniformHandle UniformRegistry::get(const std::string& name,
+		const bgfx::UniformType::Enum& type, const uint16_t& count)
+	{
+		const auto it = uniforms.find(name);
+		if (it != uniforms.end())
+		{
+			ASSERT(it->second.type == type && it->second.count == count,
+				"Uniform is already registered with another type");
+			return it->second.handle;
+		}
+
+		const bgfx::UniformHandle handle = bgfx::createUniform(name.c_str(),
+			type, count);
+		uniforms[name] = { handle, type, count };
+		return handle;
+	}
+
+	void UniformRegistry::shutdown()
+	{
+		for (const auto& [name, uniform] : uniforms)
+		{
+			bgfx::destroy(uniform.handle);
+		}
+		uniforms.clear();
+	}
+
+	uint32_t UniformRegistry::getCount()
+	{
+		return static_cast<uint32_t>(uniforms.size());
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2022 Marcus Madland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "crpch.hpp"
+
+#include "string_id.hpp"
+
+namespace core
+{
+#ifdef _DEBUG
+	static std::mutex namesMutex;
+	static std::unordered_map<uint64_t, std::string> names;
+#endif
+
+	StringID::StringID(const std::string& string)
+		: value(hash(string.data(), string.size()))
+	{
+	#ifdef _DEBUG
+		std::lock_guard<std::mutex> lock(namesMutex);
+		names.emplace(value, string);
+	#endif
+	}
+
+	const char* StringID::getString() const
+	{
+	#ifdef _DEBUG
+		std::lock_guard<std::mutex> lock(namesMutex);
+		const auto it = names.find(value);
+		if (it != names.end())
+		{
+			return it->second.c_str();
+		}
+	#endif
+		return "?";
+	}
+
+	StringID StringID::registerString(const std::string& string)
+	{
+		return StringID(string);
+	}
+}
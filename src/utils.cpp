@@ -17,18 +17,36 @@
 #include "crpch.hpp"
 
 #include <stb_image.h>
+#include <bimg/bimg.h>
+#include <bimg/encode.h>
+#include <bx/allocator.h>
+#include <bx/file.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <meshoptimizer/src/meshoptimizer.h>
+#include <cstring>
+#include <shared_mutex>
 
+#include "defines.hpp"
 #include "utils.hpp"
 #include "debug/logger.hpp"
+#include "io/mesh_cache.hpp"
+#include "jobs/job_system.hpp"
 
 namespace core::utils
 {
+	/*
+	 * The flip flag of stb image is global, decodeTexture2D holds it shared
+	 * while it is off and loadTexture2D holds it exclusively while set
+	 */
+	static std::shared_mutex stbFlipMutex;
+
 	uint8_t* loadTexture2D(const std::string& filename,
 		Texture2DParams& outParams, const bool& yFlip)
 	{
+		std::unique_lock<std::shared_mutex> lock(stbFlipMutex);
+
 		// Flip texture
 		stbi_set_flip_vertically_on_load(yFlip);
 
@@ -51,13 +69,327 @@ namespace core::utils
 		outParams.height = static_cast<uint16_t>(height);
 		outParams.channels = 4;
 
+		stbi_set_flip_vertically_on_load(false);
+		return bytes;
+	}
+
+	uint8_t* decodeTexture2D(const std::string& filename,
+		Texture2DParams& outParams, const bool& yFlip)
+	{
+		int width = 0, height = 0, channels = 0;
+		uint8_t* bytes = nullptr;
+		{
+			std::shared_lock<std::shared_mutex> lock(stbFlipMutex);
+			bytes = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+		}
+
+		if (!bytes)
+		{
+			return nullptr;
+		}
+
+		// Flip rows in place
+		if (yFlip)
+		{
+			const size_t pitch = static_cast<size_t>(width) * 4;
+			std::vector<uint8_t> row(pitch);
+			for (int y = 0; y < height / 2; y++)
+			{
+				uint8_t* top = bytes + y * pitch;
+				uint8_t* bottom = bytes + (height - 1 - y) * pitch;
+				std::memcpy(row.data(), top, pitch);
+				std::memcpy(top, bottom, pitch);
+				std::memcpy(bottom, row.data(), pitch);
+			}
+		}
+
+		outParams.width = static_cast<uint16_t>(width);
+		outParams.height = static_cast<uint16_t>(height);
+		outParams.channels = 4;
+
 		return bytes;
 	}
 
-	ref<Mesh> processMesh(const aiScene* scene, aiMesh* mesh)
+	void freeTexture2D(uint8_t* data)
+	{
+		stbi_image_free(data);
+	}
+
+	bool cookTexture2D(const std::string& filename, const std::string& outFilename,
+		const TextureCookSettings& cookSettings)
+	{
+		Texture2DParams params;
+		uint8_t* bytes = decodeTexture2D(filename, params, cookSettings.yFlip);
+		if (!bytes)
+		{
+			Logger::logError("Failed to decode texture %s", filename.c_str());
+			return false;
+		}
+
+		bx::DefaultAllocator allocator;
+		bimg::ImageContainer* image = bimg::imageAlloc(&allocator,
+			bimg::TextureFormat::RGBA8, params.width, params.height, 1, 1,
+			false, false, bytes);
+		freeTexture2D(bytes);
+
+		if (cookSettings.generateMips)
+		{
+			bimg::ImageContainer* mips = bimg::imageGenerateMips(&allocator, *image);
+			bimg::imageFree(image);
+			image = mips;
+		}
+
+		const bimg::Quality::Enum quality = cookSettings.normalMap ?
+			(cookSettings.fast ? bimg::Quality::NormalMapFastest : bimg::Quality::NormalMapDefault) :
+			(cookSettings.fast ? bimg::Quality::Fastest : bimg::Quality::Default);
+
+		// bgfx formats share bimg's values
+		bimg::ImageContainer* encoded = bimg::imageEncode(&allocator,
+			static_cast<bimg::TextureFormat::Enum>(Texture2D::toBGFX(cookSettings.format)),
+			quality, *image);
+		bimg::imageFree(image);
+
+		bx::FileWriter writer;
+		bx::Error error;
+		if (!bx::open(&writer, outFilename.c_str(), false, &error))
+		{
+			Logger::logError("Failed to open %s for writing", outFilename.c_str());
+			bimg::imageFree(encoded);
+			return false;
+		}
+
+		const bool ktx = outFilename.size() >= 4 &&
+			outFilename.compare(outFilename.size() - 4, 4, ".ktx") == 0;
+		if (ktx)
+		{
+			bimg::imageWriteKtx(&writer, *encoded, encoded->m_data,
+				encoded->m_size, &error);
+		}
+		else
+		{
+			bimg::imageWriteDds(&writer, *encoded, encoded->m_data,
+				encoded->m_size, &error);
+		}
+		bx::close(&writer);
+		bimg::imageFree(encoded);
+
+		if (!error.isOk())
+		{
+			Logger::logError("Failed to write cooked texture %s", outFilename.c_str());
+			return false;
+		}
+
+		Logger::logInfo("Cooked %s to %s", filename.c_str(), outFilename.c_str());
+		return true;
+	}
+
+	MeshOptimizationStats& MeshOptimizationStats::operator+=(
+		const MeshOptimizationStats& other)
+	{
+		triangleCount += other.triangleCount;
+		vertexCountBefore += other.vertexCountBefore;
+		vertexCountAfter += other.vertexCountAfter;
+		transformedBefore += other.transformedBefore;
+		transformedAfter += other.transformedAfter;
+		return *this;
+	}
+
+	MeshOptimizationStats optimizeMesh(std::vector<MeshVertex>& vertices,
+		std::vector<uint32_t>& indices, const float& overdrawThreshold)
+	{
+		// Cache size of the simulated GPU, warp and primitive group sizes are
+		// left out
+		constexpr uint32_t cacheSize = 16;
+
+		MeshOptimizationStats stats;
+		stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		stats.vertexCountBefore = static_cast<uint32_t>(vertices.size());
+		stats.transformedBefore = meshopt_analyzeVertexCache(indices.data(),
+			indices.size(), vertices.size(), cacheSize, 0, 0).vertices_transformed;
+
+		if (indices.empty())
+		{
+			stats.vertexCountAfter = stats.vertexCountBefore;
+			stats.transformedAfter = stats.transformedBefore;
+			return stats;
+		}
+
+		// Weld vertices that are identical in every attribute
+		std::vector<uint32_t> remap(vertices.size());
+		const size_t uniqueCount = meshopt_generateVertexRemap(remap.data(),
+			indices.data(), indices.size(), vertices.data(), vertices.size(),
+			sizeof(MeshVertex));
+		meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(),
+			remap.data());
+
+		std::vector<MeshVertex> welded(uniqueCount);
+		meshopt_remapVertexBuffer(welded.data(), vertices.data(), vertices.size(),
+			sizeof(MeshVertex), remap.data());
+
+		// Triangle order, first for the vertex cache and then in clusters
+		// sorted to draw occluders first
+		meshopt_optimizeVertexCache(indices.data(), indices.data(),
+			indices.size(), welded.size());
+		meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(),
+			&welded[0].position.x, welded.size(), sizeof(MeshVertex),
+			overdrawThreshold);
+
+		// Vertex order, unused vertices are dropped
+		vertices.resize(welded.size());
+		const size_t fetchedCount = meshopt_optimizeVertexFetch(vertices.data(),
+			indices.data(), indices.size(), welded.data(), welded.size(),
+			sizeof(MeshVertex));
+		vertices.resize(fetchedCount);
+
+		stats.vertexCountAfter = static_cast<uint32_t>(vertices.size());
+		stats.transformedAfter = meshopt_analyzeVertexCache(indices.data(),
+			indices.size(), vertices.size(), cacheSize, 0, 0).vertices_transformed;
+
+		return stats;
+	}
+
+	/*
+	 * State shared by the recursive steps of splitMesh
+	 */
+	struct SplitContext
+	{
+		span<const MeshVertex> vertices;
+		span<const uint32_t> indices;
+		uint32_t maxVertices;
+
+		std::vector<uint32_t> triangles;
+		std::vector<glm::vec3> centers;
+
+		// Vertices seen in the current pass are marked with the pass number
+		std::vector<uint32_t> marks;
+		std::vector<uint32_t> localIndices;
+		uint32_t pass = 0;
+	};
+
+	static uint32_t countChunkVertices(SplitContext& context,
+		const uint32_t begin, const uint32_t end)
+	{
+		context.pass++;
+
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			for (uint32_t j = 0; j < 3; j++)
+			{
+				const uint32_t vertex = context.indices[context.triangles[i] * 3 + j];
+				if (context.marks[vertex] != context.pass)
+				{
+					context.marks[vertex] = context.pass;
+					context.localIndices[vertex] = count++;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	static void splitTriangles(SplitContext& context, const uint32_t begin,
+		const uint32_t end, std::vector<MeshChunk>& outChunks)
+	{
+		const uint32_t vertexCount = countChunkVertices(context, begin, end);
+		if (vertexCount <= context.maxVertices)
+		{
+			// Restore the original triangle order, it may have been optimized
+			// for the vertex cache, and number the vertices in that order
+			std::sort(context.triangles.begin() + begin,
+				context.triangles.begin() + end);
+			countChunkVertices(context, begin, end);
+
+			MeshChunk& chunk = outChunks.emplace_back();
+			chunk.vertices.resize(vertexCount);
+			chunk.indices.reserve((end - begin) * 3);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					const uint32_t vertex = context.indices[context.triangles[i] * 3 + j];
+					const uint32_t localIndex = context.localIndices[vertex];
+					chunk.vertices[localIndex] = context.vertices[vertex];
+					chunk.indices.push_back(static_cast<uint16_t>(localIndex));
+				}
+			}
+			return;
+		}
+
+		// Split in the middle of the longest axis of the triangle centers
+		glm::vec3 min = context.centers[context.triangles[begin]];
+		glm::vec3 max = min;
+		for (uint32_t i = begin + 1; i < end; i++)
+		{
+			min = glm::min(min, context.centers[context.triangles[i]]);
+			max = glm::max(max, context.centers[context.triangles[i]]);
+		}
+
+		const glm::vec3 size = max - min;
+		const uint32_t axis = (size.x > size.y && size.x > size.z) ? 0 :
+			(size.y > size.z) ? 1 : 2;
+
+		const uint32_t mid = begin + (end - begin) / 2;
+		std::nth_element(context.triangles.begin() + begin,
+			context.triangles.begin() + mid, context.triangles.begin() + end,
+			[&](const uint32_t a, const uint32_t b)
+			{
+				return context.centers[a][axis] < context.centers[b][axis];
+			});
+
+		splitTriangles(context, begin, mid, outChunks);
+		splitTriangles(context, mid, end, outChunks);
+	}
+
+	void splitMesh(span<const MeshVertex> vertices, span<const uint32_t> indices,
+		std::vector<MeshChunk>& outChunks, const uint32_t& maxVertices)
+	{
+		ASSERT(indices.size() % 3 == 0, "Indices are not a triangle list");
+		ASSERT(maxVertices >= 3, "Chunks must fit at least one triangle");
+
+		SplitContext context;
+		context.vertices = vertices;
+		context.indices = indices;
+		context.maxVertices = maxVertices;
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		context.triangles.resize(triangleCount);
+		context.centers.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			context.triangles[i] = i;
+			context.centers[i] = (vertices[indices[i * 3]].position +
+				vertices[indices[i * 3 + 1]].position +
+				vertices[indices[i * 3 + 2]].position) / 3.0f;
+		}
+
+		context.marks.assign(vertices.size(), 0);
+		context.localIndices.resize(vertices.size());
+
+		if (triangleCount > 0)
+		{
+			splitTriangles(context, 0, triangleCount, outChunks);
+		}
+	}
+
+	/*
+	 * Geometry of an imported mesh before it is uploaded
+	 */
+	struct ImportedMesh
 	{
 		std::vector<MeshVertex> vertices;
-		std::vector<uint16_t> indices;
+		std::vector<uint32_t> indices;
+		uint32_t materialSlot;
+	};
+
+	static void processMesh(const aiMesh* mesh,
+		const MeshLoadSettings& loadSettings, std::vector<ImportedMesh>& outMeshes,
+		MeshOptimizationStats& outStats)
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve(mesh->mNumFaces * 3);
 		// Load verticies
 		for (uint32_t i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -72,38 +404,145 @@ namespace core::utils
 			vertex.texCoord.y = mesh->mTextureCoords[0][i].y;
 			vertices.push_back(vertex);
 		}
-		// Load indices
+		// Load indices, points and lines are skipped since meshes are drawn
+		// as triangle lists
 		for (uint32_t i = 0; i < mesh->mNumFaces; i++)
 		{
-			aiFace face = mesh->mFaces[i];
+			const aiFace& face = mesh->mFaces[i];
+			if (face.mNumIndices != 3)
+			{
+				continue;
+			}
+
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
 
-		return Mesh::create(vertices, indices, nullptr);
+		if (indices.empty())
+		{
+			Logger::logWarn("Skipped mesh without triangles");
+			return;
+		}
+
+		if (loadSettings.optimize)
+		{
+			outStats += optimizeMesh(vertices, indices);
+		}
+
+		constexpr uint32_t maxVertices = std::numeric_limits<uint16_t>::max() + 1;
+		if (loadSettings.splitLargeMeshes && vertices.size() > maxVertices)
+		{
+			std::vector<MeshChunk> chunks;
+			splitMesh(vertices, indices, chunks, maxVertices);
+
+			Logger::logInfo("Split mesh with %u vertices into %u meshes",
+				static_cast<uint32_t>(vertices.size()),
+				static_cast<uint32_t>(chunks.size()));
+
+			for (MeshChunk& chunk : chunks)
+			{
+				outMeshes.push_back({ std::move(chunk.vertices),
+					std::vector<uint32_t>(chunk.indices.begin(), chunk.indices.end()),
+					mesh->mMaterialIndex });
+			}
+			return;
+		}
+
+		outMeshes.push_back({ std::move(vertices), std::move(indices),
+			mesh->mMaterialIndex });
 	}
 
-	void processNode(const aiScene* scene, aiNode* node,
-		std::vector<ref<Mesh>>& outMeshes)
+	static void collectMeshes(const aiScene* scene, const aiNode* node,
+		std::vector<const aiMesh*>& outMeshes)
 	{
-		// Process all the node's meshes (if any)
+		// Gather all the node's meshes (if any)
 		for (unsigned int i = 0; i < node->mNumMeshes; i++)
 		{
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			outMeshes.push_back(processMesh(scene, mesh));
+			outMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 		}
 
 		// Do the same for each of its children
 		for (unsigned int i = 0; i < node->mNumChildren; i++)
 		{
-			processNode(scene, node->mChildren[i], outMeshes);
+			collectMeshes(scene, node->mChildren[i], outMeshes);
+		}
+	}
+
+	static void processMeshes(const aiScene* scene,
+		const MeshLoadSettings& loadSettings, std::vector<ImportedMesh>& outMeshes,
+		MeshOptimizationStats& outStats)
+	{
+		std::vector<const aiMesh*> sources;
+		collectMeshes(scene, scene->mRootNode, sources);
+
+		// Meshes are independent, every job writes into its own slot so the
+		// output keeps the scene order
+		const uint32_t count = static_cast<uint32_t>(sources.size());
+		std::vector<std::vector<ImportedMesh>> results(count);
+		std::vector<MeshOptimizationStats> stats(count);
+
+		JobSystem::parallelFor(count, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					processMesh(sources[i], loadSettings, results[i], stats[i]);
+				}
+			});
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			outStats += stats[i];
+			for (ImportedMesh& mesh : results[i])
+			{
+				outMeshes.push_back(std::move(mesh));
+			}
 		}
 	}
 
 	std::vector<ref<Mesh>> loadMesh(const std::string& filename, const MeshLoadSettings& loadSettings)
+	{
+		std::vector<uint32_t> materialSlots;
+		return loadMesh(filename, loadSettings, materialSlots);
+	}
+
+	std::vector<ref<Mesh>> loadMesh(const std::string& filename,
+		const MeshLoadSettings& loadSettings, std::vector<uint32_t>& outMaterialSlots)
 	{
 		std::vector<ref<Mesh>> meshes;
 
+		MeshParams params;
+		params.keepCpuData = loadSettings.keepCpuData;
+		params.vertexFormat = loadSettings.vertexFormat;
+
+		// Backends without 32 bit indices can only draw split meshes
+		const bool splitLargeMeshes = loadSettings.splitLargeMeshes ||
+			!(bgfx::getCaps()->supported & BGFX_CAPS_INDEX32);
+
+		// Settings that change the imported geometry, a cache written with
+		// other settings is not reused
+		const uint32_t importFlags = (loadSettings.optimize ? 1 : 0) |
+			(splitLargeMeshes ? 2 : 0);
+		const std::string cacheFilename = filename + ".meshcache";
+
+		if (loadSettings.useCache)
+		{
+			const ref<MeshCache> cache = MeshCache::open(cacheFilename, filename,
+				importFlags);
+			if (cache)
+			{
+				for (uint32_t i = 0; i < cache->getMeshCount(); i++)
+				{
+					meshes.push_back(cache->createMesh(i, params));
+					outMaterialSlots.push_back(cache->getMaterialSlot(i));
+				}
+
+				Logger::logInfo("Loaded %u meshes from %s",
+					static_cast<uint32_t>(meshes.size()),
+					cacheFilename.c_str());
+				return meshes;
+			}
+		}
+
 		Assimp::Importer import;
 		const aiScene* scene = import.ReadFile(filename, aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -113,9 +552,48 @@ namespace core::utils
 			return meshes;
 		}
 
-		processNode(scene, scene->mRootNode, meshes);
+		std::vector<ImportedMesh> imported;
+		MeshOptimizationStats stats;
+		MeshLoadSettings importSettings = loadSettings;
+		importSettings.splitLargeMeshes = splitLargeMeshes;
+		processMeshes(scene, importSettings, imported, stats);
+
+		if (loadSettings.optimize)
+		{
+			Logger::logInfo("Optimized %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertices %u -> %u",
+				stats.triangleCount, stats.getACMRBefore(), stats.getACMRAfter(),
+				stats.getATVRBefore(), stats.getATVRAfter(),
+				stats.vertexCountBefore, stats.vertexCountAfter);
+		}
+
+		if (loadSettings.useCache)
+		{
+			std::vector<MeshCacheData> cacheData;
+			cacheData.reserve(imported.size());
+			for (const ImportedMesh& mesh : imported)
+			{
+				cacheData.push_back({ mesh.vertices, mesh.indices, mesh.materialSlot });
+			}
+
+			if (!MeshCache::write(cacheFilename, filename, importFlags, cacheData))
+			{
+				Logger::logWarn("Failed to write mesh cache %s", cacheFilename.c_str());
+			}
+		}
+
+		// GPU resources are only created from the calling thread
+		for (ImportedMesh& mesh : imported)
+		{
+			if (ref<Mesh> created = Mesh::create(std::move(mesh.vertices),
+				std::move(mesh.indices), nullptr, params))
+			{
+				meshes.push_back(std::move(created));
+				outMaterialSlots.push_back(mesh.materialSlot);
+			}
+		}
 
-		Logger::logInfo("Loaded %u meshes", meshes.size());
+		Logger::logInfo("Loaded %u meshes",
+			static_cast<uint32_t>(meshes.size()));
 		return meshes;
 	}
-}
\ No newline at end of file
+}